@@ -21,9 +21,9 @@
 #include "wait.h"
 #include "lide_alib.h"
 
-static BYTE write_taskfile_lba(struct IDEUnit *unit, UBYTE command, ULONG lba, UBYTE sectorCount, UBYTE features);
-static BYTE write_taskfile_lba48(struct IDEUnit *unit, UBYTE command, ULONG lba, UBYTE sectorCount, UBYTE features);
-static BYTE write_taskfile_chs(struct IDEUnit *unit, UBYTE command, ULONG lba, UBYTE sectorCount, UBYTE features);
+static BYTE write_taskfile_lba(struct IDEUnit *unit, UBYTE command, ULONG lba, UWORD sectorCount, UBYTE features);
+static BYTE write_taskfile_lba48(struct IDEUnit *unit, UBYTE command, ULONG lba, UWORD sectorCount, UBYTE features);
+static BYTE write_taskfile_chs(struct IDEUnit *unit, UBYTE command, ULONG lba, UWORD sectorCount, UBYTE features);
 
 /**
  * ata_status_reg_delay
@@ -49,6 +49,7 @@ static void __attribute__((always_inline)) ata_status_reg_delay(struct IDEUnit *
  * ata_save_error
  *
  * Save the contents of the drive registers so that errors can be reported in sense data
+ * The features register shadow is dropped as the error may have overwritten it
  *
 */
 static void ata_save_error(struct IDEUnit *unit) {
@@ -58,6 +59,9 @@ static void ata_save_error(struct IDEUnit *unit) {
     unit->last_error[3] = *unit->drive.lbaLow;
     unit->last_error[4] = *unit->drive.status_command;
     unit->last_error[5] = *unit->drive.devHead;
+
+    // Some CF cards and bridges share one latch for Error and Features
+    unit->itask->shadowFeatures = -1;
 }
 
 /**
@@ -72,6 +76,141 @@ static bool __attribute__((always_inline)) ata_check_error(struct IDEUnit *unit)
     return (*unit->drive.status_command & (ata_flag_error | ata_flag_df));
 }
 
+#ifdef ATA_IRQ
+ULONG ata_irq_handler(struct IDETask *itask asm("a1"));
+
+// Exec looks at the Z flag rather than d0 to decide if the next server should run
+asm (
+    "       .text                   \n"
+    "       .even                   \n"
+    "_ata_irq_server:               \n"
+    "       jsr     _ata_irq_handler\n"
+    "       tst.l   d0              \n"
+    "       rts                     \n"
+);
+void ata_irq_server(void);
+
+/**
+ * ata_irq_handler
+ *
+ * Interrupt server for the channel, signals the IDE task once the drive has dropped BSY
+ * The boards have no interrupt status register so the alternate status register is checked instead,
+ * reading the status register then acknowledges INTRQ
+ *
+ * @param itask Pointer to the IDETask struct
+ * @return non-zero if the interrupt was for this channel
+*/
+ULONG __attribute__((used)) ata_irq_handler(struct IDETask *itask asm("a1")) {
+    struct ExecBase *SysBase = *(struct ExecBase **)4UL;
+
+    if (!itask->irqWaiting || (*itask->irqAltStatus & ata_flag_busy)) return 0;
+
+    (void)*itask->irqStatus;
+    itask->irqWaiting = false;
+    Signal(itask->task,itask->irqMask);
+
+    return 1;
+}
+
+/**
+ * ata_irq_init
+ *
+ * Mask INTRQ on the channel and install the interrupt server
+ * The device control register is decoded by IDE_CS1, which 2 channel boards use for the second channel instead
+ * so those boards, and any channel where the server can't be installed, keep polling
+ *
+ * @param itask Pointer to the IDETask struct
+*/
+void ata_irq_init(struct IDETask *itask) {
+    struct ExecBase *SysBase = itask->dev->SysBase;
+
+    itask->irqMask    = 0;
+    itask->irqWaiting = false;
+
+    if (itask->numChannels != 1) return;
+
+    itask->irqStatus    = (UBYTE *)((void *)itask->cd->cd_BoardAddr + CHANNEL_0 + ata_reg_status);
+    itask->irqAltStatus = (UBYTE *)((void *)itask->cd->cd_BoardAddr + CHANNEL_1 + ata_reg_altStatus);
+
+    // INTRQ is only unmasked while the task is waiting for it
+    *itask->irqAltStatus = ata_devctl_nien;
+
+    if ((itask->irqSignal = AllocSignal(-1)) == -1) return;
+
+    itask->irqServer.is_Node.ln_Type = NT_INTERRUPT;
+    itask->irqServer.is_Node.ln_Pri  = 0;
+    itask->irqServer.is_Node.ln_Name = itask->task->tc_Node.ln_Name;
+    itask->irqServer.is_Data         = itask;
+    itask->irqServer.is_Code         = (void (*)())&ata_irq_server;
+    itask->irqMask                   = (1 << itask->irqSignal);
+
+    AddIntServer(ATA_IRQ_INTB,&itask->irqServer);
+    Info("IRQ: Server installed for channel %ld\n",(ULONG)itask->channel);
+}
+
+/**
+ * ata_irq_free
+ *
+ * Mask INTRQ on the channel and remove the interrupt server
+ *
+ * @param itask Pointer to the IDETask struct
+*/
+void ata_irq_free(struct IDETask *itask) {
+    struct ExecBase *SysBase = itask->dev->SysBase;
+
+    if (itask->irqMask == 0) return;
+
+    *itask->irqAltStatus = ata_devctl_nien;
+    RemIntServer(ATA_IRQ_INTB,&itask->irqServer);
+    FreeSignal(itask->irqSignal);
+    itask->irqMask = 0;
+}
+
+/**
+ * ata_wait_irq
+ *
+ * Sleep until the drive raises INTRQ or the time has passed, whichever comes first
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param micros Time to wait if no interrupt arrives
+ * @return true if the interrupt server is in use so the caller can stop spinning
+*/
+static bool ata_wait_irq(struct IDEUnit *unit, ULONG micros) {
+    struct ExecBase *SysBase = unit->SysBase;
+    struct IDETask *itask = unit->itask;
+    struct timerequest *tr = itask->tr;
+
+    if (itask->irqMask == 0) {
+        wait_us(tr,micros);
+        return false;
+    }
+
+    SetSignal(0,itask->irqMask);
+    itask->irqWaiting = true;
+    *itask->irqAltStatus = 0; // Unmask INTRQ, a pending interrupt will be raised straight away
+
+    tr->tr_node.io_Command = TR_ADDREQUEST;
+    tr->tr_time.tv_sec     = 0;
+    tr->tr_time.tv_micro   = micros;
+    SendIO((struct IORequest *)tr);
+
+    Wait(itask->irqMask | (1 << tr->tr_node.io_Message.mn_ReplyPort->mp_SigBit));
+
+    *itask->irqAltStatus = ata_devctl_nien;
+    itask->irqWaiting = false;
+
+    if (!CheckIO((struct IORequest *)tr)) AbortIO((struct IORequest *)tr);
+    WaitIO((struct IORequest *)tr);
+
+    return true;
+}
+#else
+static inline bool ata_wait_irq(struct IDEUnit *unit, ULONG micros) {
+    wait_us(unit->itask->tr,micros);
+    return false;
+}
+#endif
+
 /**
  * ata_wait_drq
  *
@@ -81,7 +220,6 @@ static bool __attribute__((always_inline)) ata_check_error(struct IDEUnit *unit)
  * @param fast More aggressive polling, 1000 tries before timer wait vs 100
 */
 static bool ata_wait_drq(struct IDEUnit *unit, ULONG tries, bool fast) {
-    struct timerequest *tr = unit->itask->tr;
     Trace("wait_drq enter\n");
     UBYTE status;
 
@@ -94,7 +232,8 @@ static bool ata_wait_drq(struct IDEUnit *unit, ULONG tries, bool fast) {
             if ((status & ata_flag_drq) != 0) return true;
             if (status & (ata_flag_error | ata_flag_df)) return false;
         }
-        wait_us(tr,ATA_DRQ_WAIT_LOOP_US);
+        // Once the interrupt wakes us there's no need to keep spinning
+        if (ata_wait_irq(unit,ATA_DRQ_WAIT_LOOP_US)) loops = 1;
     }
     Trace("wait_drq timeout\n");
     return false;
@@ -108,16 +247,16 @@ static bool ata_wait_drq(struct IDEUnit *unit, ULONG tries, bool fast) {
  * @param tries Tries, sets the timeout
 */
 static bool ata_wait_not_busy(struct IDEUnit *unit, ULONG tries) {
-    struct timerequest *tr = unit->itask->tr;
+    int loops = 100;
 
     ata_status_reg_delay(unit);
 
     for (int i=0; i < tries; i++) {
         // Try a bunch of times before imposing the speed penalty of the timer...
-        for (int j=0; j<100; j++) {
+        for (int j=0; j<loops; j++) {
             if ((*unit->drive.status_command & ata_flag_busy) == 0) return true;
         }
-        wait_us(tr,ATA_BSY_WAIT_LOOP_US);
+        if (ata_wait_irq(unit,ATA_BSY_WAIT_LOOP_US)) loops = 1;
     }
     return false;
 }
@@ -130,16 +269,16 @@ static bool ata_wait_not_busy(struct IDEUnit *unit, ULONG tries) {
  * @param tries Tries, sets the timeout
 */
 static bool ata_wait_ready(struct IDEUnit *unit, ULONG tries) {
-    struct timerequest *tr = unit->itask->tr;
+    int loops = 1000;
 
     ata_status_reg_delay(unit);
 
     for (int i=0; i < tries; i++) {
         // Try a bunch of times before imposing the speed penalty of the timer...
-        for (int j=0; j<1000; j++) {
+        for (int j=0; j<loops; j++) {
             if ((*unit->drive.status_command & (ata_flag_ready | ata_flag_busy)) == ata_flag_ready) return true;
         }
-        wait_us(tr,ATA_RDY_WAIT_LOOP_US);
+        if (ata_wait_irq(unit,ATA_RDY_WAIT_LOOP_US)) loops = 1;
     }
     return false;
 }
@@ -203,7 +342,7 @@ bool ata_identify(struct IDEUnit *unit, UWORD *buffer)
     *unit->drive.lbaLow         = 0;
     *unit->drive.lbaMid         = 0;
     *unit->drive.lbaHigh        = 0;
-    *unit->drive.error_features = 0;
+    ata_write_features(unit,0);
     *unit->drive.devHead        = drvSel;
     *unit->drive.status_command = ATA_CMD_IDENTIFY;
 
@@ -267,6 +406,26 @@ static ULONG ata_bench(struct IDEUnit *unit, void *xfer_routine, void *buffer) {
     return ticks;
 }
 
+/**
+ * ata_line_xfer_ok
+ *
+ * Check if move16 can be used, this needs a 68040/68060 and a data port mirrored across a line aligned 512 byte window
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @return true if line_move16 can be used
+ */
+static bool ata_line_xfer_ok(struct IDEUnit *unit) {
+    struct ExecBase *SysBase = unit->SysBase;
+
+    if ((SysBase->AttnFlags & (AFF_68040 | AFF_68060)) == 0)
+        return false;
+
+    if ((unit->drive.lbaMid - unit->drive.lbaLow) != 512)
+        return false;
+
+    return ((ULONG)unit->drive.data & 15) == 0;
+}
+
 /**
  * ata_autoselect_xfer
  * 
@@ -277,7 +436,6 @@ static ULONG ata_bench(struct IDEUnit *unit, void *xfer_routine, void *buffer) {
  */
 static enum xfer ata_autoselect_xfer(struct IDEUnit *unit) {
     struct ExecBase *SysBase = unit->SysBase;
-    ULONG ticks;
     void *buf;
 
     // longword_movem requires 512 Byte register spacing
@@ -292,15 +450,27 @@ static enum xfer ata_autoselect_xfer(struct IDEUnit *unit) {
     if (SysBase->LibNode.lib_Version < 36)
         return longword_movem;
     
-    if ((buf = AllocMem(512,MEMF_ANY))) {
-        enum xfer method;
-        ticks = ata_bench(unit,&ata_read_long_movem,buf);
-        if (ticks > 0 && ata_bench(unit,&ata_read_long_move,buf) < ticks) {
+    // Extra space so that the buffer can be aligned for move16 or made odd for the unaligned routine
+    if ((buf = AllocMem(512+16,MEMF_ANY))) {
+        enum xfer method = longword_movem;
+        ULONG *ticks = unit->stats.xferTicks;
+        void *line_buf = (void *)(((ULONG)buf + 15) & ~15);
+
+        ticks[longword_movem] = ata_bench(unit,&ata_read_long_movem,buf);
+        ticks[longword_move]  = ata_bench(unit,&ata_read_long_move,buf);
+        if (ticks[longword_movem] > 0 && ticks[longword_move] < ticks[longword_movem]) {
             method = longword_move;
-        } else {
-            method = longword_movem;
         }
-        FreeMem(buf,512);
+        if (ticks[method] > 0 && ata_line_xfer_ok(unit)) {
+            ticks[line_move16] = ata_bench(unit,&ata_read_line_move16,line_buf);
+            if (ticks[line_move16] < ticks[method]) {
+                method = line_move16;
+            }
+        }
+        // Not selectable, timed so that the odd buffer path can be compared with the others
+        ticks[XFER_TICKS_UNALIGNED] = ata_bench(unit,&ata_read_unaligned_long,(UBYTE *)buf + 1);
+
+        FreeMem(buf,512+16);
         return method;
     } else {
         return longword_movem;
@@ -316,6 +486,10 @@ static enum xfer ata_autoselect_xfer(struct IDEUnit *unit) {
  * @param method Transfer routine
  */
 void ata_set_xfer(struct IDEUnit *unit, enum xfer method) {
+    // move16 is an illegal instruction before the 68040
+    if (method == line_move16 && !ata_line_xfer_ok(unit))
+        method = longword_move;
+
     switch (method) {
         default:
         case longword_movem:
@@ -334,9 +508,45 @@ void ata_set_xfer(struct IDEUnit *unit, enum xfer method) {
 
             unit->xferMethod = longword_move;
             break;
+        case line_move16:
+            unit->read_fast       = &ata_read_line_move16;
+            unit->read_unaligned  = &ata_read_unaligned_long;
+            unit->write_fast      = &ata_write_line_move16;
+            unit->write_unaligned = &ata_write_unaligned_long;
+
+            unit->xferMethod = line_move16;
+            break;
     }
 }
 
+/**
+ * ata_set_features
+ *
+ * Send a SET FEATURES subcommand to the drive
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param feature Subcommand for the features register
+ * @param count Value for the sector count register
+ * @return non-zero on error
+*/
+static BYTE ata_set_features(struct IDEUnit *unit, UBYTE feature, UBYTE count) {
+    UBYTE drvSel = (unit->primary) ? 0xE0 : 0xF0;
+    BYTE error;
+
+    ata_select(unit,drvSel,true);
+
+    if ((error = write_taskfile_lba(unit,ATA_CMD_SET_FEATURES,0,count,feature)) != 0)
+        return error;
+
+    if (!ata_wait_not_busy(unit,ATA_BSY_WAIT_COUNT))
+        return IOERR_UNITBUSY;
+
+    if (ata_check_error(unit))
+        return IOERR_ABORTED;
+
+    return 0;
+}
+
 /**
  * ata_init_unit
  *
@@ -353,6 +563,8 @@ bool ata_init_unit(struct IDEUnit *unit) {
     unit->blockSize       = 0;
     unit->present         = false;
     unit->mediumPresent   = false;
+    unit->flushCommand    = 0;
+    unit->writeCache      = false;
 
     ULONG offset;
     UWORD *buf;
@@ -403,14 +615,7 @@ bool ata_init_unit(struct IDEUnit *unit) {
         unit->logicalSectors  = buf[ata_identify_logical_sectors+1] << 16 | buf[ata_identify_logical_sectors];
         unit->blockShift      = 0;
         unit->mediumPresent   = true;
-        unit->multipleCount   = buf[ata_identify_multiple] & 0xFF;
-
-        if (unit->multipleCount > 0 && (ata_set_multiple(unit,unit->multipleCount) == 0)) {
-            unit->xferMultiple = true;
-        } else {
-            unit->xferMultiple = false;
-            unit->multipleCount = 1;
-        }
+        unit->multipleMax     = buf[ata_identify_multiple] & 0xFF;
 
         // Support LBA-48 but only up to 2TB
         if ((buf[ata_identify_features] & ata_feature_lba48) && unit->logicalSectors >= 0xFFFFFFF) {
@@ -441,6 +646,30 @@ bool ata_init_unit(struct IDEUnit *unit) {
 
         if (unit->logicalSectors == 0 || unit->heads == 0 || unit->cylinders == 0) goto ident_failed;
 
+        // Use the fastest DRQ block size, or the drive's maximum if it can't be timed
+        if (ata_tune_multiple(unit) != 0) {
+            ata_configure_multiple(unit,unit->multipleMax);
+        }
+        Info("INIT: Multiple count: %ld\n",(ULONG)unit->multipleCount);
+
+        // The write cache is only turned on if the drive can be told to flush it
+        if ((buf[ata_identify_features] & ata_feature_valid_mask) == ata_feature_valid &&
+            (buf[ata_identify_features] & ata_feature_flush)) {
+
+            if (unit->lba48 && (buf[ata_identify_features] & ata_feature_flush_ext)) {
+                unit->flushCommand = ATA_CMD_FLUSH_CACHE_EXT;
+            } else {
+                unit->flushCommand = ATA_CMD_FLUSH_CACHE;
+            }
+
+            if (buf[ata_identify_cmdset_enabled] & ata_cmdset_write_cache) {
+                unit->writeCache = true;
+            } else if (buf[ata_identify_cmdset] & ata_cmdset_write_cache) {
+                unit->writeCache = (ata_set_features(unit,ATA_FEATURE_WCACHE_ON,0) == 0);
+            }
+        }
+        Info("INIT: Write cache: %ld\n",(ULONG)unit->writeCache);
+
         if (unit->logicalSectors >= 267382800) {
             // For drives larger than 127GB fudge the geometry
             unit->heads           = 63;
@@ -509,7 +738,7 @@ bool ata_set_multiple(struct IDEUnit *unit, BYTE multiple) {
     *unit->drive.lbaLow         = 0;
     *unit->drive.lbaMid         = 0;
     *unit->drive.lbaHigh        = 0;
-    *unit->drive.error_features = 0;
+    ata_write_features(unit,0);
     *unit->drive.status_command = ATA_CMD_SET_MULTIPLE;
 
     if (!ata_wait_not_busy(unit,ATA_BSY_WAIT_COUNT))
@@ -526,6 +755,135 @@ bool ata_set_multiple(struct IDEUnit *unit, BYTE multiple) {
     return 0;
 }
 
+/**
+ * ata_configure_multiple
+ *
+ * Set the DRQ block size used for transfers, 0 disables READ/WRITE MULTIPLE
+ * Falls back to single sector DRQ blocks if the drive rejects the value
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param multiple DRQ Block size
+ * @return non-zero on error
+*/
+BYTE ata_configure_multiple(struct IDEUnit *unit, UBYTE multiple) {
+    BYTE error = 0;
+
+    if (unit->atapi) return IOERR_NOCMD;
+
+    if (multiple > unit->multipleMax) return IOERR_BADLENGTH;
+
+    if (multiple > 0 && (error = ata_set_multiple(unit,multiple)) == 0) {
+        unit->xferMultiple  = true;
+        unit->multipleCount = multiple;
+    } else {
+        unit->xferMultiple  = false;
+        unit->multipleCount = 1;
+    }
+
+    return error;
+}
+
+/**
+ * ata_tune_sum
+ *
+ * Checksum the tuning buffer so a block size that returns bad data can be rejected
+ *
+ * @param buffer Pointer to the tuning buffer
+ * @return sum of the buffer's longwords
+*/
+static ULONG ata_tune_sum(ULONG *buffer) {
+    ULONG sum = 0;
+
+    for (int i=0; i<(ATA_TUNE_SECTORS * 512 / 4); i++) {
+        sum += buffer[i];
+    }
+
+    return sum;
+}
+
+/**
+ * ata_tune_multiple
+ *
+ * Time ATA_TUNE_PASSES reads of the first ATA_TUNE_SECTORS sectors at each power of 2 DRQ block size the drive supports
+ * Timing stops at the first size that fails or returns different data, then the fastest size is selected
+ * The timings are kept in the unit stats so that lidetool can show them
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @return non-zero if the block sizes could not be timed
+*/
+BYTE ata_tune_multiple(struct IDEUnit *unit) {
+    struct ExecBase *SysBase = unit->SysBase;
+    struct Device *TimerBase = unit->itask->tr->tr_node.io_Device;
+    struct EClockVal *startTime;
+    struct EClockVal *endTime;
+    ULONG *buf;
+    ULONG sum;
+    ULONG ticks;
+    ULONG best_ticks = 0;
+    UBYTE best = 0;
+    BYTE error = 0;
+
+    if (unit->atapi) return IOERR_NOCMD;
+
+    for (int i=0; i<MULTIPLE_STEPS; i++) {
+        unit->stats.multipleTicks[i] = 0;
+    }
+
+    // ReadEClock not supported before Kick 2.0
+    if (TimerBase->dd_Library.lib_Version < 36) return IOERR_NOCMD;
+
+    if (unit->multipleMax == 0 || unit->logicalSectors < ATA_TUNE_SECTORS) return IOERR_NOCMD;
+
+    if ((buf = AllocMem(ATA_TUNE_SECTORS * 512,MEMF_ANY)) == NULL) return TDERR_NoMem;
+
+    if ((startTime = (struct EClockVal *)AllocMem(sizeof(struct EClockVal),MEMF_ANY|MEMF_CLEAR))) {
+        if ((endTime = (struct EClockVal *)AllocMem(sizeof(struct EClockVal),MEMF_ANY|MEMF_CLEAR))) {
+
+            // Reference read, this also gets the sectors into the drive's cache so only the transfer is timed
+            if ((error = ata_configure_multiple(unit,1)) == 0 &&
+                (error = ata_read(buf,0,ATA_TUNE_SECTORS,unit)) == 0) {
+
+                sum = ata_tune_sum(buf);
+
+                for (int i=0; i<MULTIPLE_STEPS && (1 << i) <= unit->multipleMax; i++) {
+                    if (ata_configure_multiple(unit,(1 << i)) != 0) break;
+
+                    ReadEClock(startTime);
+
+                    for (int pass=0; pass<ATA_TUNE_PASSES && error == 0; pass++) {
+                        error = ata_read(buf,0,ATA_TUNE_SECTORS,unit);
+                    }
+
+                    ReadEClock(endTime);
+                    ticks = (*(uint64_t *)endTime) - (*(uint64_t *)startTime);
+
+                    if (error != 0 || ata_tune_sum(buf) != sum) {
+                        Warn("ATA: DRQ block size %ld is unstable\n",(ULONG)(1 << i));
+                        error = 0;
+                        break;
+                    }
+
+                    unit->stats.multipleTicks[i] = ticks;
+                    Trace("ATA: DRQ block size %ld took %ld ticks\n",(ULONG)(1 << i),ticks);
+
+                    if (best == 0 || ticks < best_ticks) {
+                        best_ticks = ticks;
+                        best = (1 << i);
+                    }
+                }
+            }
+            FreeMem(endTime,sizeof(struct EClockVal));
+        }
+        FreeMem(startTime,sizeof(struct EClockVal));
+    }
+
+    FreeMem(buf,ATA_TUNE_SECTORS * 512);
+
+    if (best == 0) return (error) ? error : IOERR_NOCMD;
+
+    return ata_configure_multiple(unit,best);
+}
+
 #pragma GCC push_options
 #pragma GCC optimize ("-O3")
 
@@ -540,21 +898,35 @@ bool ata_set_multiple(struct IDEUnit *unit, BYTE multiple) {
  * @returns error
 */
 BYTE ata_read(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
+    struct SGEntry sg = {buffer, count};
+
+    return ata_read_sg(&sg,lba,count,unit);
+}
+
+/**
+ * ata_read_sg
+ *
+ * Read contiguous blocks from the unit into a list of buffers
+ * @param sg Buffers to fill in order, their counts must add up to count
+ * @param lba LBA Address
+ * @param count Number of blocks to transfer
+ * @param unit Pointer to the unit structure
+ * @returns error
+*/
+BYTE ata_read_sg(struct SGEntry *sg, ULONG lba, ULONG count, struct IDEUnit *unit) {
     Trace("ata_read enter\n");
     Trace("ATA: Request sector count: %ld\n",count);
 
     UBYTE error = 0;
     ULONG txn_count; // Amount of sectors to transfer in the current READ/WRITE command
+    ULONG max_txn = (unit->lba48) ? MAX_TRANSFER_SECTORS_LBA48 : MAX_TRANSFER_SECTORS;
 
-    UBYTE command;
+    UBYTE command     = (unit->xferMultiple) ? ATA_CMD_READ_MULTIPLE : ATA_CMD_READ;
+    UBYTE command_ext = (unit->xferMultiple) ? ATA_CMD_READ_MULTIPLE_EXT : ATA_CMD_READ_EXT;
     UBYTE multipleCount = unit->multipleCount;
     volatile void *dataRegister = unit->drive.data;
-
-    if (unit->lba48) {
-        command = ATA_CMD_READ_MULTIPLE_EXT;
-    } else {
-        command = (unit->xferMultiple) ? ATA_CMD_READ_MULTIPLE : ATA_CMD_READ;
-    }
+    UBYTE *buffer = sg->buffer;
+    ULONG sg_count = sg->count; // Sectors left in the current buffer
 
     void (*ata_xfer)(void *source asm("a0"), void *destination asm("a1"));
 
@@ -575,15 +947,15 @@ BYTE ata_read(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
     }
 
     /**
-     * Transfer up-to MAX_TRANSFER_SECTORS per ATA command invocation
+     * Transfer up-to MAX_TRANSFER_SECTORS (MAX_TRANSFER_SECTORS_LBA48 for LBA48 units) per ATA command invocation
      *
      * count:          Number of sectors to transfer for this io request
      * txn_count:      Number of sectors to transfer to/from the drive in one ATA command transaction
      * multiple_count: Max number of sectors that can be transferred before polling DRQ
      */
     while (count > 0) {
-        if (count >= MAX_TRANSFER_SECTORS) { // Transfer 256 Sectors at a time
-            txn_count = MAX_TRANSFER_SECTORS;
+        if (count >= max_txn) {             // Transfer 256 (or 65536 with LBA48) Sectors at a time
+            txn_count = max_txn;
         } else {
             txn_count = count;               // Get any remainders
         }
@@ -591,7 +963,16 @@ BYTE ata_read(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
 
         Trace("ATA: XFER Count: %ld, txn_count: %ld\n",count,txn_count);
 
-        if ((error = unit->write_taskfile(unit,command,lba,txn_count,0)) != 0) {
+        if (!unit->lba48) {
+            error = unit->write_taskfile(unit,command,lba,txn_count,0);
+        } else if (txn_count <= MAX_TRANSFER_SECTORS && (lba + txn_count) < ATA_LBA28_LIMIT) {
+            // LBA28 form needs half the register writes of LBA48
+            error = write_taskfile_lba(unit,command,lba,txn_count,0);
+        } else {
+            error = write_taskfile_lba48(unit,command_ext,lba,txn_count,0);
+        }
+
+        if (error != 0) {
             ata_save_error(unit);
             return error;
         }
@@ -606,8 +987,15 @@ BYTE ata_read(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
 
             /* Transfer up to (multiple_count) sectors before polling DRQ again */
             for (int i = 0; i < multipleCount && txn_count; i++) {
+                if (sg_count == 0) {
+                    sg++;
+                    buffer   = sg->buffer;
+                    sg_count = sg->count;
+                    ata_xfer = (((ULONG)buffer) & 0x01) ? unit->read_unaligned : unit->read_fast;
+                }
                 ata_xfer((void *)dataRegister,buffer);
                 txn_count--;
+                sg_count--;
                 buffer += 512;
             }
         }
@@ -628,22 +1016,36 @@ BYTE ata_read(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
  * @returns error
 */
 BYTE ata_write(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
+    struct SGEntry sg = {buffer, count};
+
+    return ata_write_sg(&sg,lba,count,unit);
+}
+
+/**
+ * ata_write_sg
+ *
+ * Write contiguous blocks to the unit from a list of buffers
+ * @param sg Buffers to write in order, their counts must add up to count
+ * @param lba LBA Address
+ * @param count Number of blocks to transfer
+ * @param unit Pointer to the unit structure
+ * @returns error
+*/
+BYTE ata_write_sg(struct SGEntry *sg, ULONG lba, ULONG count, struct IDEUnit *unit) {
     Trace("ata_write enter\n");
     Trace("ATA: Request sector count: %ld\n",count);
 
     UBYTE error = 0;
 
     ULONG txn_count; // Amount of sectors to transfer in the current READ/WRITE command
+    ULONG max_txn = (unit->lba48) ? MAX_TRANSFER_SECTORS_LBA48 : MAX_TRANSFER_SECTORS;
 
-    UBYTE command;
+    UBYTE command     = (unit->xferMultiple) ? ATA_CMD_WRITE_MULTIPLE : ATA_CMD_WRITE;
+    UBYTE command_ext = (unit->xferMultiple) ? ATA_CMD_WRITE_MULTIPLE_EXT : ATA_CMD_WRITE_EXT;
     UBYTE multipleCount = unit->multipleCount;
     volatile void *dataRegister = unit->drive.data;
-
-    if (unit->lba48) {
-        command = ATA_CMD_WRITE_MULTIPLE_EXT;
-    } else {
-        command = (unit->xferMultiple) ? ATA_CMD_WRITE_MULTIPLE : ATA_CMD_WRITE;
-    }
+    UBYTE *buffer = sg->buffer;
+    ULONG sg_count = sg->count; // Sectors left in the current buffer
 
     void (*ata_xfer)(void *source asm("a0"), void *destination asm("a1"));
 
@@ -664,15 +1066,15 @@ BYTE ata_write(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
     }
 
     /**
-     * Transfer up-to MAX_TRANSFER_SECTORS per ATA command invocation
+     * Transfer up-to MAX_TRANSFER_SECTORS (MAX_TRANSFER_SECTORS_LBA48 for LBA48 units) per ATA command invocation
      *
      * count:          Number of sectors to transfer for this io request
      * txn_count:      Number of sectors to transfer to/from the drive in one ATA command transaction
      * multiple_count: Max number of sectors that can be transferred before polling DRQ
      */
     while (count > 0) {
-        if (count >= MAX_TRANSFER_SECTORS) { // Transfer 256 Sectors at a time
-            txn_count = MAX_TRANSFER_SECTORS;
+        if (count >= max_txn) {             // Transfer 256 (or 65536 with LBA48) Sectors at a time
+            txn_count = max_txn;
         } else {
             txn_count = count;               // Get any remainders
         }
@@ -680,7 +1082,16 @@ BYTE ata_write(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
 
         Trace("ATA: XFER Count: %ld, txn_count: %ld\n",count,txn_count);
 
-        if ((error = unit->write_taskfile(unit,command,lba,txn_count,0)) != 0) {
+        if (!unit->lba48) {
+            error = unit->write_taskfile(unit,command,lba,txn_count,0);
+        } else if (txn_count <= MAX_TRANSFER_SECTORS && (lba + txn_count) < ATA_LBA28_LIMIT) {
+            // LBA28 form needs half the register writes of LBA48
+            error = write_taskfile_lba(unit,command,lba,txn_count,0);
+        } else {
+            error = write_taskfile_lba48(unit,command_ext,lba,txn_count,0);
+        }
+
+        if (error != 0) {
             ata_save_error(unit);
             return error;
         }
@@ -695,8 +1106,15 @@ BYTE ata_write(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
 
             /* Transfer up to (multiple_count) sectors before polling DRQ again */
             for (int i = 0; i < multipleCount && txn_count; i++) {
+                if (sg_count == 0) {
+                    sg++;
+                    buffer   = sg->buffer;
+                    sg_count = sg->count;
+                    ata_xfer = (((ULONG)buffer) & 0x01) ? unit->write_unaligned : unit->write_fast;
+                }
                 ata_xfer(buffer,(void *)dataRegister);
                 txn_count--;
+                sg_count--;
                 buffer += 512;
             }
         }
@@ -706,49 +1124,13 @@ BYTE ata_write(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
     return 0;
 }
 
-/**
- * ata_read_unaligned_long
- *
- * Read data to an unaligned buffer
- * @param source Pointer to the drive data port
- * @param destination Pointer to the data buffer
-*/
-void ata_read_unaligned_long(void *source asm("a0"), void *destination asm("a1")) {
-    ULONG readLong;
-    UBYTE *dest = (UBYTE *)destination;
-
-    for (int i=0; i<(512/4); i++) {          // Read (512 / 4) Long words from drive
-        readLong = *(ULONG *)source;
-        dest[0] = ((readLong >> 24) & 0xFF); // Write it out in 4 bytes
-        dest[1] = ((readLong >> 16) & 0xFF);
-        dest[2] = ((readLong >> 8) & 0xFF);
-        dest[3] = (readLong & 0xFF);
-        dest += 4;                           // Increment dest pointer by 4 bytes
-    }
-}
-
-/**
- * ata_write_unaligned_long
- *
- * Write data from an unaligned buffer
- * @param source Pointer to the data buffer
- * @param destination Pointer to the drive data port
-*/
-void ata_write_unaligned_long(void *source asm("a0"), void *destination asm("a1")) {
-    UBYTE *src = (UBYTE *)source;
-    for (int i=0; i<(512/4); i++) {  // Write (512 / 4) Long words to drive
-        *(ULONG *)destination = (src[0] << 24 | src[1] << 16 | src[2] << 8 | src[3]);
-        src += 4;
-    }
-}
-
 /**
  * write_taskfile_chs
  *
  * @param unit Pointer to an IDEUnit struct
  * @param lba  Pointer to the LBA variable
 */
-static BYTE write_taskfile_chs(struct IDEUnit *unit, UBYTE command, ULONG lba, UBYTE sectorCount, UBYTE features) {
+static BYTE write_taskfile_chs(struct IDEUnit *unit, UBYTE command, ULONG lba, UWORD sectorCount, UBYTE features) {
     UWORD cylinder = (lba / (unit->heads * unit->sectorsPerTrack));
     UBYTE head     = ((lba / unit->sectorsPerTrack) % unit->heads) & 0xF;
     UBYTE sector   = (lba % unit->sectorsPerTrack) + 1;
@@ -762,11 +1144,11 @@ static BYTE write_taskfile_chs(struct IDEUnit *unit, UBYTE command, ULONG lba, U
 
     *unit->shadowDevHead         = devHead;
     *unit->drive.devHead        = devHead;
-    *unit->drive.sectorCount    = sectorCount; // Count value of 0 indicates to transfer 256 sectors
+    *unit->drive.sectorCount    = (UBYTE)(sectorCount); // Count value of 0 indicates to transfer 256 sectors
     *unit->drive.lbaLow         = (UBYTE)(sector);
     *unit->drive.lbaMid         = (UBYTE)(cylinder);
     *unit->drive.lbaHigh        = (UBYTE)(cylinder >> 8);
-    *unit->drive.error_features = features;
+    ata_write_features(unit,features);
     *unit->drive.status_command = command;
 
     return 0;
@@ -778,7 +1160,7 @@ static BYTE write_taskfile_chs(struct IDEUnit *unit, UBYTE command, ULONG lba, U
  * @param unit Pointer to an IDEUnit struct
  * @param lba  Pointer to the LBA variable
 */
-static BYTE write_taskfile_lba(struct IDEUnit *unit, UBYTE command, ULONG lba, UBYTE sectorCount, UBYTE features) {
+static BYTE write_taskfile_lba(struct IDEUnit *unit, UBYTE command, ULONG lba, UWORD sectorCount, UBYTE features) {
     BYTE devHead;
 
     if (!ata_wait_ready(unit,ATA_RDY_WAIT_COUNT))
@@ -788,11 +1170,11 @@ static BYTE write_taskfile_lba(struct IDEUnit *unit, UBYTE command, ULONG lba, U
 
     *unit->shadowDevHead         = devHead;
     *unit->drive.devHead        = devHead;
-    *unit->drive.sectorCount    = sectorCount; // Count value of 0 indicates to transfer 256 sectors
+    *unit->drive.sectorCount    = (UBYTE)(sectorCount); // Count value of 0 indicates to transfer 256 sectors
     *unit->drive.lbaLow         = (UBYTE)(lba);
     *unit->drive.lbaMid         = (UBYTE)(lba >> 8);
     *unit->drive.lbaHigh        = (UBYTE)(lba >> 16);
-    *unit->drive.error_features = features;
+    ata_write_features(unit,features);
     *unit->drive.status_command = command;
 
     return 0;
@@ -804,20 +1186,20 @@ static BYTE write_taskfile_lba(struct IDEUnit *unit, UBYTE command, ULONG lba, U
  * @param unit Pointer to an IDEUnit struct
  * @param lba  Pointer to the LBA variable
 */
-static BYTE write_taskfile_lba48(struct IDEUnit *unit, UBYTE command, ULONG lba, UBYTE sectorCount, UBYTE features) {
+static BYTE write_taskfile_lba48(struct IDEUnit *unit, UBYTE command, ULONG lba, UWORD sectorCount, UBYTE features) {
 
     if (!ata_wait_ready(unit,ATA_RDY_WAIT_COUNT))
         return HFERR_SelTimeout;
 
-    *unit->drive.sectorCount    = (sectorCount == 0) ? 1 : 0;
+    *unit->drive.sectorCount    = (UBYTE)(sectorCount >> 8);
     *unit->drive.lbaHigh        = 0;
     *unit->drive.lbaMid         = 0;
     *unit->drive.lbaLow         = (UBYTE)(lba >> 24);
-    *unit->drive.sectorCount    = sectorCount; // Count value of 0 indicates to transfer 256 sectors
+    *unit->drive.sectorCount    = (UBYTE)(sectorCount); // Count value of 0 indicates to transfer 65536 sectors
     *unit->drive.lbaHigh        = (UBYTE)(lba >> 16);
     *unit->drive.lbaMid         = (UBYTE)(lba >> 8);
     *unit->drive.lbaLow         = (UBYTE)(lba);
-    *unit->drive.error_features = features;
+    ata_write_features(unit,features);
     *unit->drive.status_command = command;
 
     return 0;
@@ -825,6 +1207,40 @@ static BYTE write_taskfile_lba48(struct IDEUnit *unit, UBYTE command, ULONG lba,
 
 #pragma GCC pop_options
 
+/**
+ * ata_flush
+ *
+ * Make sure all written data is on the media by having the drive flush its write cache
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @returns error
+*/
+BYTE ata_flush(struct IDEUnit *unit) {
+    UBYTE drvSel = (unit->primary) ? 0xE0 : 0xF0;
+    BYTE error;
+
+    if (unit->atapi || unit->flushCommand == 0) return 0;
+
+    ata_select(unit,drvSel,true);
+
+    if ((error = write_taskfile_lba(unit,unit->flushCommand,0,0,0)) != 0) {
+        ata_save_error(unit);
+        return error;
+    }
+
+    if (!ata_wait_not_busy(unit,ATA_FLUSH_WAIT_COUNT)) {
+        ata_save_error(unit);
+        return IOERR_UNITBUSY;
+    }
+
+    if (ata_check_error(unit)) {
+        ata_save_error(unit);
+        return TDERR_NotSpecified;
+    }
+
+    return 0;
+}
+
 /**
  * ata_set_pio
  *
@@ -19,6 +19,11 @@
 #if MAX_TRANSFER_SECTORS > 256
 #error "MAX_TRANSFER_SECTORS cannot be larger than 256"
 #endif
+#define MAX_TRANSFER_SECTORS_LBA48 65536 // Max amount of sectors per READ/WRITE MULTIPLE EXT command
+#define ATA_LBA28_LIMIT 0x10000000 // A transfer must end below this to use LBA28, drives report at most 0x0FFFFFFF LBA28 sectors
+
+#define ATA_TUNE_SECTORS 128 // Sectors read per pass when timing each DRQ block size
+#define ATA_TUNE_PASSES  2   // Timed passes per DRQ block size
 
 #ifdef SIMPLE_IDE
 
@@ -54,6 +59,8 @@
 
 #define drv_sel_secondary (1<<4)
 
+#define ata_devctl_nien (1<<1) // Device control: mask INTRQ
+
 #define ata_flag_busy  (1<<7)
 #define ata_flag_ready (1<<6)
 #define ata_flag_df    (1<<5)
@@ -67,11 +74,19 @@
 #define ATA_CMD_READ               0x20
 #define ATA_CMD_READ_MULTIPLE      0xC4
 #define ATA_CMD_READ_MULTIPLE_EXT  0x29
+#define ATA_CMD_READ_EXT           0x24
 #define ATA_CMD_WRITE              0x30
 #define ATA_CMD_WRITE_MULTIPLE     0xC5
 #define ATA_CMD_WRITE_MULTIPLE_EXT 0x39
+#define ATA_CMD_WRITE_EXT          0x34
 #define ATA_CMD_SET_MULTIPLE       0xC6
 #define ATA_CMD_SET_FEATURES       0xEF
+#define ATA_CMD_FLUSH_CACHE        0xE7
+#define ATA_CMD_FLUSH_CACHE_EXT    0xEA
+
+// SET FEATURES subcommands
+#define ATA_FEATURE_WCACHE_ON      0x02
+#define ATA_FEATURE_WCACHE_OFF     0x82
 
 // Identify data word offsets
 #define ata_identify_cylinders       1
@@ -84,13 +99,20 @@
 #define ata_identify_capabilities    49
 #define ata_identify_logical_sectors 60
 #define ata_identify_pio_modes       64
+#define ata_identify_cmdset          82
 #define ata_identify_features        83
+#define ata_identify_cmdset_enabled  85
 #define ata_identify_lba48_sectors   100
 #define ataf_multiple (1<<8)
 
 #define ata_capability_lba (1<<9)
 #define ata_capability_dma (1<<8)
 #define ata_feature_lba48  (1<<10)
+#define ata_feature_flush     (1<<12)
+#define ata_feature_flush_ext (1<<13)
+#define ata_feature_valid_mask 0xC000 // Word 83 is only valid if bits 15:14 are 01
+#define ata_feature_valid      0x4000
+#define ata_cmdset_write_cache (1<<5) // Words 82 (supported) and 85 (enabled)
 
 enum xfer_dir {
     READ,
@@ -109,20 +131,55 @@ enum xfer_dir {
 #define ATA_RDY_WAIT_S 3
 #define ATA_RDY_WAIT_COUNT (ATA_RDY_WAIT_S * 1000 * (1000 / ATA_RDY_WAIT_LOOP_US))
 
+#define ATA_FLUSH_WAIT_S 30 // Flushing a large write cache can take a while
+#define ATA_FLUSH_WAIT_COUNT (ATA_FLUSH_WAIT_S * 1000 * (1000 / ATA_BSY_WAIT_LOOP_US))
+
+#ifdef ATA_IRQ
+#if ATA_IRQ == 6
+#define ATA_IRQ_INTB INTB_EXTER
+#else
+#define ATA_IRQ_INTB INTB_PORTS
+#endif
+#endif
+
 
 bool ata_init_unit(struct IDEUnit *);
+#ifdef ATA_IRQ
+void ata_irq_init(struct IDETask *itask);
+void ata_irq_free(struct IDETask *itask);
+#endif
 bool ata_select(struct IDEUnit *unit, UBYTE select, bool wait);
 bool ata_identify(struct IDEUnit *, UWORD *);
 bool ata_set_multiple(struct IDEUnit *unit, BYTE multiple);
+BYTE ata_configure_multiple(struct IDEUnit *unit, UBYTE multiple);
+BYTE ata_tune_multiple(struct IDEUnit *unit);
 void ata_set_xfer(struct IDEUnit *unit, enum xfer method);
 
 BYTE ata_read(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit);
 BYTE ata_write(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit);
+BYTE ata_read_sg(struct SGEntry *sg, ULONG lba, ULONG count, struct IDEUnit *unit);
+BYTE ata_write_sg(struct SGEntry *sg, ULONG lba, ULONG count, struct IDEUnit *unit);
+BYTE ata_flush(struct IDEUnit *unit);
 BYTE ata_set_pio(struct IDEUnit *unit, UBYTE pio);
 BYTE scsi_ata_passthrough( struct IDEUnit *unit, struct SCSICmd *cmd);
 
-void ata_read_unaligned_long(void *source asm("a0"), void *destination asm("a1"));
-void ata_write_unaligned_long(void *source asm("a0"), void *destination asm("a1"));
+/**
+ * ata_write_features
+ *
+ * Write the features register unless the channel's shadow copy shows that it already holds the value
+ * Both drives on the channel latch the write and a successful command leaves the register alone,
+ * unlike the LBA and count registers which the drive may update when a command completes
+ * Resets and errors make the shadow unknown (-1) as they may change the latch
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param features Value for the features register
+*/
+static inline void ata_write_features(struct IDEUnit *unit, UBYTE features) {
+    if (unit->itask->shadowFeatures != features) {
+        *unit->drive.error_features = features;
+        unit->itask->shadowFeatures = features;
+    }
+}
 
 #endif // SD_DRIVER
 
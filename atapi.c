@@ -16,12 +16,159 @@
 #include "device.h"
 #include "ata.h"
 #include "atapi.h"
+#include "cache.h"
 #include "scsi.h"
 #include "string.h"
 #include "wait.h"
 #include "blockcopy.h"
 #include "lide_alib.h"
 
+/**
+ * Command blocks for the packets the driver builds itself (reads, TEST UNIT READY, REQUEST SENSE...)
+ * Allocated once per unit so no memory is allocated for them on the I/O path
+ *
+*/
+struct ATAPICmdPool {
+    UWORD busy;         // One bit per command block in use
+    struct SCSICmd cmd[ATAPI_CMD_SLOTS];
+    UBYTE cdb[ATAPI_CMD_SLOTS][SZ_CDB_12];
+};
+
+/**
+ * atapi_cmd_pool_init
+ *
+ * Allocate the command blocks of an ATAPI unit
+ * Without them the commands are allocated as they are needed
+ *
+ * @param unit Pointer to an IDEUnit struct
+*/
+void atapi_cmd_pool_init(struct IDEUnit *unit) {
+    struct ExecBase *SysBase = unit->SysBase;
+
+    unit->cmdPool = AllocMem(sizeof(struct ATAPICmdPool),MEMF_ANY|MEMF_CLEAR);
+}
+
+/**
+ * atapi_cmd_pool_free
+ *
+ * Free the command blocks of an ATAPI unit
+ *
+ * @param unit Pointer to an IDEUnit struct
+*/
+void atapi_cmd_pool_free(struct IDEUnit *unit) {
+    struct ExecBase *SysBase = unit->SysBase;
+
+    if (unit->cmdPool) {
+        FreeMem(unit->cmdPool,sizeof(struct ATAPICmdPool));
+        unit->cmdPool = NULL;
+    }
+}
+
+/**
+ * Descriptor of the loaded medium, kept until atapi_update_presence() sees it change
+ * Capacity and block size are the unit geometry, read by atapi_get_capacity() when the medium appears
+ *
+*/
+struct ATAPIMedium {
+    struct SCSI_CD_TOC toc; // Full TOC with MSF addresses, first so the drive transfers it word aligned
+    UWORD tocLength;        // Bytes of the TOC read for this medium, 0 if there is none
+    bool  written;          // Changed by a SCSI direct command, TOC and capacity are left to the drive
+    bool  tocFailed;        // The TOC of this medium couldn't be read (blank disc, not a CD), don't try again
+};
+
+/**
+ * atapi_medium_init
+ *
+ * Allocate the medium descriptor of an ATAPI unit
+ *
+ * @param unit Pointer to an IDEUnit struct
+*/
+void atapi_medium_init(struct IDEUnit *unit) {
+    struct ExecBase *SysBase = unit->SysBase;
+
+    unit->medium = AllocMem(sizeof(struct ATAPIMedium),MEMF_ANY|MEMF_CLEAR);
+}
+
+/**
+ * atapi_medium_free
+ *
+ * Free the medium descriptor of an ATAPI unit
+ *
+ * @param unit Pointer to an IDEUnit struct
+*/
+void atapi_medium_free(struct IDEUnit *unit) {
+    struct ExecBase *SysBase = unit->SysBase;
+
+    if (unit->medium) {
+        FreeMem(unit->medium,sizeof(struct ATAPIMedium));
+        unit->medium = NULL;
+    }
+}
+
+/**
+ * atapi_medium_written
+ *
+ * A SCSI direct command may have written the medium, stop answering for it until the next medium
+ *
+ * @param unit Pointer to an IDEUnit struct
+*/
+void atapi_medium_written(struct IDEUnit *unit) {
+    if (unit->medium) {
+        unit->medium->tocLength = 0;
+        unit->medium->written   = true;
+    }
+}
+
+/**
+ * atapi_get_cmd
+ *
+ * Take a cleared command block of the unit, like MakeSCSICmd
+ * A command and the REQUEST SENSE or READ CAPACITY it leads to can be in use at the same time,
+ * a block is only allocated if all of them are taken
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param cdbSize Size of the CDB, at most SZ_CDB_12
+ * @returns Pointer to an initialized SCSICmd struct
+*/
+static struct SCSICmd *atapi_get_cmd(struct IDEUnit *unit, ULONG cdbSize) {
+    struct ATAPICmdPool *pool = unit->cmdPool;
+    struct SCSICmd *cmd;
+
+    if (pool) {
+        for (int i = 0; i < ATAPI_CMD_SLOTS; i++) {
+            if (!(pool->busy & (1 << i))) {
+                pool->busy |= (1 << i);
+                cmd = &pool->cmd[i];
+                memset(cmd,0,sizeof(struct SCSICmd));
+                memset(pool->cdb[i],0,SZ_CDB_12);
+                cmd->scsi_Command   = pool->cdb[i];
+                cmd->scsi_CmdLength = cdbSize;
+                return cmd;
+            }
+        }
+    }
+
+    return MakeSCSICmd(cdbSize);
+}
+
+/**
+ * atapi_put_cmd
+ *
+ * Give back a command block taken with atapi_get_cmd
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param cmd Pointer to the SCSICmd struct
+*/
+static void atapi_put_cmd(struct IDEUnit *unit, struct SCSICmd *cmd) {
+    struct ATAPICmdPool *pool = unit->cmdPool;
+
+    if (pool && cmd >= &pool->cmd[0] && cmd < &pool->cmd[ATAPI_CMD_SLOTS]) {
+        pool->busy &= ~(1 << (cmd - &pool->cmd[0]));
+    } else {
+        DeleteSCSICmd(cmd);
+    }
+}
+
 /**
  * atapi_status_reg_delay
  *
@@ -142,6 +289,7 @@ void atapi_dev_reset(struct IDEUnit *unit) {
     Info("ATAPI: Resetting device\n");
     atapi_wait_not_bsy(unit,10);
     *unit->drive.status_command = ATA_CMD_DEVICE_RESET;
+    unit->itask->shadowFeatures = -1; // Register contents are lost in the reset
     atapi_wait_not_bsy(unit,ATAPI_BSY_WAIT_COUNT);
 
 }
@@ -186,7 +334,7 @@ bool atapi_identify(struct IDEUnit *unit, UWORD *buffer) {
     *unit->drive.lbaLow         = 0;
     *unit->drive.lbaMid         = 0;
     *unit->drive.lbaHigh        = 0;
-    *unit->drive.error_features = 0;
+    ata_write_features(unit,0);
     *unit->drive.status_command = ATAPI_CMD_IDENTIFY;
 
     if (!atapi_wait_drq(unit,ATAPI_DRQ_WAIT_COUNT)) {
@@ -215,32 +363,26 @@ bool atapi_identify(struct IDEUnit *unit, UWORD *buffer) {
 }
 
 /**
- * atapi_translate
+ * atapi_rw_chunk
  *
- * Translate TD commands to ATAPI and issue them to the device
+ * Issue a READ (10) / WRITE (10) to the device, with retries
  *
+ * @param cmd Pointer to the SCSICmd struct to use
  * @param io_Data Pointer to the data buffer
  * @param lba LBA to transfer
- * @param count Number of LBAs to transfer
- * @param io_Actual Pointer to the io_Actual field of the ioreq
+ * @param count Number of LBAs to transfer, at most 65535
  * @param unit Pointer to the IDE Unit
  * @param direction Transfer direction
- * @returns error
+ * @returns error, bytes transferred in cmd->scsi_Actual
 */
-BYTE atapi_translate(APTR io_Data, ULONG lba, ULONG count, ULONG *io_Actual, struct IDEUnit *unit, enum xfer_dir direction)
+static BYTE atapi_rw_chunk(struct SCSICmd *cmd, APTR io_Data, ULONG lba, ULONG count, struct IDEUnit *unit, enum xfer_dir direction)
 {
-    Trace("atapi_translate enter\n");
-    struct SCSICmd *cmd = MakeSCSICmd(SZ_CDB_10);
-    if (cmd == NULL) return TDERR_NoMem;
     struct SCSI_CDB_10 *cdb = (struct SCSI_CDB_10 *)cmd->scsi_Command;
     UBYTE errorCode = 0;
     UBYTE senseKey  = 0;
     UBYTE asc       = 0;
     UBYTE asq       = 0;
 
-    if (count == 0) {
-        return IOERR_BADLENGTH;
-    }
     Trace("%ld lba %ld count\n %ld bs\n",lba,count,unit->blockShift);
     BYTE err = 0;
     BYTE ret = 0;
@@ -263,19 +405,18 @@ BYTE atapi_translate(APTR io_Data, ULONG lba, ULONG count, ULONG *io_Actual, str
         cdb->length    = (UWORD)count;
 
         if ((err = atapi_packet(cmd,unit)) == 0) {
-            goto done;
+            return 0;
         } else {
             if (cmd->scsi_Status == 2) {
                 // Unit reported CHECK STATUS
                 // Request the sense data
                 if ((ret = atapi_request_sense(unit,&errorCode,&senseKey,&asc,&asq)) != 0) {
                     // Got an error even trying to get the sense data :/
-                    goto done;
+                    return ret;
                 }
                 switch (senseKey) {
                     case 0x01:                       // Recovered error
-                        ret = 0;
-                        goto done;
+                        return 0;
 
                     case 0x02:                       // Unit not ready
                         if (asc == 0x4) {            // Becoming ready
@@ -283,9 +424,8 @@ BYTE atapi_translate(APTR io_Data, ULONG lba, ULONG count, ULONG *io_Actual, str
                             wait(unit->itask->tr,1);   // Wait
                             continue;                // and try again
                         } else {
-                            ret = TDERR_DiskChanged; // No media
                             atapi_update_presence(unit,false);
-                            goto done;
+                            return TDERR_DiskChanged; // No media
                         }
 
                     case 0x06:                       // Media changed or unit completed reset
@@ -293,8 +433,7 @@ BYTE atapi_translate(APTR io_Data, ULONG lba, ULONG count, ULONG *io_Actual, str
                         continue;                    // Try the command again
 
                     case 0x07:                       // Disk is write protected
-                        ret = TDERR_WriteProt;
-                        goto done;
+                        return TDERR_WriteProt;
 
                     default:                         // Anything else
                         ret = TDERR_NotSpecified;
@@ -309,11 +448,64 @@ BYTE atapi_translate(APTR io_Data, ULONG lba, ULONG count, ULONG *io_Actual, str
         }
     }
 
-done:
+    return ret;
+}
+
+/**
+ * atapi_translate
+ *
+ * Translate TD commands to ATAPI and issue them to the device
+ * Large requests are split into back-to-back commands of up to ATAPI_XFER_MAX_BYTES that end on multiples of that size,
+ * which also keeps the block count within the 16 bits of READ (10) / WRITE (10)
+ *
+ * @param io_Data Pointer to the data buffer
+ * @param lba LBA to transfer
+ * @param count Number of LBAs to transfer
+ * @param io_Actual Pointer to the io_Actual field of the ioreq
+ * @param unit Pointer to the IDE Unit
+ * @param direction Transfer direction
+ * @returns error
+*/
+BYTE atapi_translate(APTR io_Data, ULONG lba, ULONG count, ULONG *io_Actual, struct IDEUnit *unit, enum xfer_dir direction)
+{
+    Trace("atapi_translate enter\n");
+
+    if (count == 0) {
+        return IOERR_BADLENGTH;
+    }
+
+    // READ CAPACITY failed for this medium, the block size isn't known
+    if (unit->blockShift == 0) {
+        Warn("ATAPI: Transfer with unknown block size\n");
+        return TDERR_DiskChanged;
+    }
+
+    struct SCSICmd *cmd = atapi_get_cmd(unit,SZ_CDB_10);
+    if (cmd == NULL) return TDERR_NoMem;
+
+    ULONG chunk = ATAPI_XFER_MAX_BYTES >> unit->blockShift;
+    ULONG n;
+    BYTE ret = 0;
+
+    *io_Actual = 0;
+
+    while (count > 0) {
+        n = chunk - (lba & (chunk - 1));
+        if (n > count) n = count;
+
+        ret = atapi_rw_chunk(cmd,io_Data,lba,n,unit,direction);
+        *io_Actual += cmd->scsi_Actual;
+
+        if (ret != 0) break;
+
+        io_Data += n << unit->blockShift;
+        lba     += n;
+        count   -= n;
+    }
+
     Trace("atapi_packet returns %ld\n",ret);
-    *io_Actual = cmd->scsi_Actual;
 
-    DeleteSCSICmd(cmd);
+    atapi_put_cmd(unit,cmd);
 
     return ret;
 }
@@ -364,15 +556,15 @@ BYTE atapi_packet(struct SCSICmd *cmd, struct IDEUnit *unit) {
         goto end;
     }
 
-    if (cmd->scsi_Length > 65534) {
-        byte_count = 65534;
+    if (cmd->scsi_Length > ATAPI_BYTE_COUNT_MAX) {
+        byte_count = ATAPI_BYTE_COUNT_MAX;
     } else {
         byte_count = cmd->scsi_Length;
     }
 
     *unit->drive.lbaMid         = byte_count & 0xFF;
     *unit->drive.lbaHigh        = byte_count >> 8 & 0xFF;
-    *unit->drive.error_features = 0;
+    ata_write_features(unit,0);
     *unit->drive.devHead        = drvSelHead;
     *unit->drive.status_command = ATAPI_CMD_PACKET;
 
@@ -483,6 +675,7 @@ end:
         unit->last_error[0] = *unit->drive.error_features;
         unit->last_error[1] = *unit->drive.status_command;
         unit->last_error[2] = *unit->drive.sectorCount;
+        unit->itask->shadowFeatures = -1; // Error and Features may share a latch
         senseKey = *unit->drive.error_features >> 4;
         Warn("ATAPI ERROR!\n");
         Warn("Sense Key: %02lx\n",senseKey);
@@ -511,7 +704,7 @@ end:
  * @returns nonzero if there was an error
 */
 BYTE atapi_test_unit_ready(struct IDEUnit *unit) {
-    struct SCSICmd *cmd = MakeSCSICmd(SZ_CDB_10);
+    struct SCSICmd *cmd = atapi_get_cmd(unit,SZ_CDB_10);
     if (cmd == NULL) return TDERR_NoMem;
     struct SCSI_CDB_10 *cdb = (struct SCSI_CDB_10 *)cmd->scsi_Command;
 
@@ -568,11 +761,93 @@ BYTE atapi_test_unit_ready(struct IDEUnit *unit) {
 
 done:
     atapi_update_presence(unit,(ret == 0)); // Update the media presence
-    DeleteSCSICmd(cmd);
+    atapi_put_cmd(unit,cmd);
+
+    return ret;
+}
+
+/**
+ * atapi_media_event
+ *
+ * Poll the media class of GET EVENT STATUS NOTIFICATION
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param event Pointer to the media event code
+ * @param present Pointer to the Media Present flag
+ * @returns nonzero if there was an error, IOERR_NOCMD if the drive doesn't report media events
+*/
+static BYTE atapi_media_event(struct IDEUnit *unit, UBYTE *event, bool *present) {
+    struct SCSICmd *cmd = atapi_get_cmd(unit,SZ_CDB_10);
+    if (cmd == NULL) return TDERR_NoMem;
+
+    UWORD data[4] = {0};
+    UBYTE *buf = (UBYTE *)data;
+    BYTE ret;
+
+    cmd->scsi_Command[0]  = SCSI_CMD_GET_EVENT_STATUS;
+    cmd->scsi_Command[1]  = 0x01;                       // Polled
+    cmd->scsi_Command[4]  = ATAPI_EVENT_CLASS_MEDIA;
+    cmd->scsi_Command[8]  = sizeof(data);
+    cmd->scsi_CmdLength   = SZ_CDB_10;
+    cmd->scsi_Data        = data;
+    cmd->scsi_Length      = sizeof(data);
+    cmd->scsi_Flags       = SCSIF_READ;
+
+    ret = atapi_packet(cmd,unit);
 
+    if (ret != 0) {
+        // Illegal request, the drive predates GET EVENT STATUS NOTIFICATION
+        if (cmd->scsi_Status == SCSI_CHECK_CONDITION && (unit->last_error[0] >> 4) == 0x05)
+            ret = IOERR_NOCMD;
+    } else if (cmd->scsi_Actual < sizeof(data) || (buf[2] & 0x80) || (buf[2] & 0x07) != 4) {
+        // No event available or no media class descriptor
+        ret = IOERR_NOCMD;
+    } else {
+        *event   = buf[4] & 0x0F;
+        *present = (buf[5] & 0x02) ? true : false;
+    }
+
+    atapi_put_cmd(unit,cmd);
     return ret;
 }
 
+/**
+ * atapi_check_media
+ *
+ * Check the medium for TD_CHANGESTATE and the disk change task
+ * Drives that report media events are polled with GET EVENT STATUS NOTIFICATION,
+ * this needs no REQUEST SENSE when the tray is empty and doesn't consume a pending unit attention.
+ * TEST UNIT READY is only sent when the drive reports an event or its state doesn't match ours
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @returns nonzero if there is no medium
+*/
+BYTE atapi_check_media(struct IDEUnit *unit) {
+    UBYTE event;
+    bool present;
+    BYTE ret;
+
+    if (!unit->noEvents) {
+        ret = atapi_media_event(unit,&event,&present);
+
+        if (ret == 0) {
+            if (event == ATAPI_MEDIA_EVENT_NONE && present == unit->mediumPresent) {
+                return (present) ? 0 : TDERR_DiskChanged;
+            }
+
+            if (event >= ATAPI_MEDIA_EVENT_NEW && unit->mediumPresent) {
+                // The medium was swapped between polls, drop the old one before TUR picks up the new one
+                atapi_update_presence(unit,false);
+            }
+        } else if (ret == IOERR_NOCMD) {
+            Info("ATAPI: No media events, polling with TEST UNIT READY\n");
+            unit->noEvents = true;
+        }
+    }
+
+    return atapi_test_unit_ready(unit);
+}
+
 /**
  * atapi_request_sense
  *
@@ -585,27 +860,21 @@ done:
  * @return non-zero on error
 */
 BYTE atapi_request_sense(struct IDEUnit *unit, UBYTE *errorCode, UBYTE *senseKey, UBYTE *asc, UBYTE *asq) {
-    struct ExecBase *SysBase = unit->SysBase;
-
-    struct SCSICmd *cmd = MakeSCSICmd(SZ_CDB_10);
+    struct SCSICmd *cmd = atapi_get_cmd(unit,SZ_CDB_10);
     if (cmd == NULL) return TDERR_NoMem;
     UBYTE *cdb = (UBYTE *)cmd->scsi_Command;
 
-    UBYTE *buf;
-
-    if ((buf = AllocMem(18,MEMF_CLEAR|MEMF_ANY)) == NULL) {
-        DeleteSCSICmd(cmd);
-        return TDERR_NoMem;
-    }
+    UWORD sense[(ATAPI_SENSE_LENGTH + 1) / 2] = {0}; // Word aligned for the PIO transfer
+    UBYTE *buf = (UBYTE *)sense;
 
     UBYTE ret;
 
     cdb[0]                = SCSI_CMD_REQUEST_SENSE;
-    cdb[4]                = 18;
+    cdb[4]                = ATAPI_SENSE_LENGTH;
     cmd->scsi_Command     = (UBYTE *)cdb;
     cmd->scsi_CmdLength   = sizeof(struct SCSI_CDB_10);
-    cmd->scsi_Length      = 18;
-    cmd->scsi_Data        = (UWORD *)buf;
+    cmd->scsi_Length      = ATAPI_SENSE_LENGTH;
+    cmd->scsi_Data        = sense;
     cmd->scsi_Flags       = SCSIF_READ;
 
     ret = atapi_packet(cmd,unit);
@@ -617,8 +886,7 @@ BYTE atapi_request_sense(struct IDEUnit *unit, UBYTE *errorCode, UBYTE *senseKey
     *asc       = buf[12];
     *asq       = buf[13];
 
-    DeleteSCSICmd(cmd);
-    if (buf) FreeMem(buf,18);
+    atapi_put_cmd(unit,cmd);
     return ret;
 }
 
@@ -631,7 +899,7 @@ BYTE atapi_request_sense(struct IDEUnit *unit, UBYTE *errorCode, UBYTE *senseKey
  * @return non-zero on error
 */
 BYTE atapi_get_capacity(struct IDEUnit *unit) {
-    struct SCSICmd *cmd = MakeSCSICmd(SZ_CDB_10);
+    struct SCSICmd *cmd = atapi_get_cmd(unit,SZ_CDB_10);
     if (cmd == NULL) return TDERR_NoMem;
     struct SCSI_CDB_10 *cdb = (struct SCSI_CDB_10 *)cmd->scsi_Command;
 
@@ -668,7 +936,7 @@ BYTE atapi_get_capacity(struct IDEUnit *unit) {
     }
     Trace("New geometry: %ld %ld\n",unit->logicalSectors, unit->blockSize);
 
-    DeleteSCSICmd(cmd);
+    atapi_put_cmd(unit,cmd);
     return ret;
 }
 
@@ -686,7 +954,7 @@ BYTE atapi_get_capacity(struct IDEUnit *unit) {
  * @return Non-zero on error
 */
 BYTE atapi_mode_sense(struct IDEUnit *unit, BYTE page_code, BYTE subpage_code, UWORD *buffer, UWORD length, UWORD *actual, BOOL dbd) {
-    struct SCSICmd *cmd = MakeSCSICmd(SZ_CDB_10);
+    struct SCSICmd *cmd = atapi_get_cmd(unit,SZ_CDB_10);
     if (cmd == NULL) return TDERR_NoMem;
 
     UBYTE *cdb = cmd->scsi_Command;
@@ -712,7 +980,7 @@ BYTE atapi_mode_sense(struct IDEUnit *unit, BYTE page_code, BYTE subpage_code, U
 
     if (actual) *actual = cmd->scsi_Actual;
 
-    DeleteSCSICmd(cmd);
+    atapi_put_cmd(unit,cmd);
     return ret;
 }
 
@@ -742,7 +1010,7 @@ BYTE atapi_scsi_mode_sense_6(struct SCSICmd *cmd, struct IDEUnit *unit) {
         return TDERR_NoMem;
     }
 
-    cmd_sense = MakeSCSICmd(SZ_CDB_10);
+    cmd_sense = atapi_get_cmd(unit,SZ_CDB_10);
 
     if (cmd_sense == NULL) {
         return TDERR_NoMem;
@@ -783,7 +1051,7 @@ BYTE atapi_scsi_mode_sense_6(struct SCSICmd *cmd, struct IDEUnit *unit) {
     cmd->scsi_SenseActual = cmd_sense->scsi_SenseActual;
 
     FreeMem(buf,len);
-    DeleteSCSICmd(cmd_sense);
+    atapi_put_cmd(unit,cmd_sense);
     return ret;
 }
 
@@ -818,7 +1086,7 @@ BYTE atapi_scsi_mode_select_6(struct SCSICmd *cmd, struct IDEUnit *unit) {
     src = (UBYTE *)cmd->scsi_Data;
     dst = buf;
 
-    cmd_select = MakeSCSICmd(SZ_CDB_10);
+    cmd_select = atapi_get_cmd(unit,SZ_CDB_10);
 
     if (cmd_select == NULL) {
         return TDERR_NoMem;
@@ -852,7 +1120,7 @@ BYTE atapi_scsi_mode_select_6(struct SCSICmd *cmd, struct IDEUnit *unit) {
     cmd->scsi_CmdActual   = cmd->scsi_CmdLength;
     cmd->scsi_Actual      = cmd_select->scsi_Actual;
 
-    DeleteSCSICmd(cmd_select);
+    atapi_put_cmd(unit,cmd_select);
     FreeMem(buf,bufSize);
 
     return ret;
@@ -869,11 +1137,9 @@ BYTE atapi_scsi_mode_select_6(struct SCSICmd *cmd, struct IDEUnit *unit) {
  * @returns non-zero on error
 */
 BYTE atapi_scsi_read_write_6 (struct SCSICmd *cmd, struct IDEUnit *unit) {
-    struct ExecBase *SysBase = unit->SysBase;
-
     BYTE ret;
-    struct SCSI_CDB_10 *cdb = AllocMem(sizeof(struct SCSI_CDB_10),MEMF_ANY|MEMF_CLEAR);
-    if (!cdb) return TDERR_NoMem;
+    struct SCSI_CDB_10 cdb10 = {0};
+    struct SCSI_CDB_10 *cdb  = &cdb10;
 
     struct SCSI_CDB_6 *oldcdb  = (struct SCSI_CDB_6 *)cmd->scsi_Command;
 
@@ -893,8 +1159,6 @@ BYTE atapi_scsi_read_write_6 (struct SCSICmd *cmd, struct IDEUnit *unit) {
         ret = atapi_packet_unaligned(cmd,unit);
     }
 
-    FreeMem(cdb,sizeof(struct SCSI_CDB_10));
-
     cmd->scsi_Command = (BYTE *)oldcdb;
 
     return ret;
@@ -953,7 +1217,7 @@ BYTE atapi_start_stop_unit(struct IDEUnit *unit, bool start, bool loej) {
     if (loej)  operation |= (1<<1);
     if (start) operation |= (1<<0);
 
-    if ((cmd = MakeSCSICmd(SZ_CDB_10)) == NULL) return TDERR_NoMem;
+    if ((cmd = atapi_get_cmd(unit,SZ_CDB_10)) == NULL) return TDERR_NoMem;
 
     cmd->scsi_Command[0] = SCSI_CMD_START_STOP_UNIT;
     cmd->scsi_Command[1] = (1<<0); // Immediate bit set
@@ -961,7 +1225,7 @@ BYTE atapi_start_stop_unit(struct IDEUnit *unit, bool start, bool loej) {
 
     ret = atapi_packet(cmd,unit);
 
-    DeleteSCSICmd(cmd);
+    atapi_put_cmd(unit,cmd);
 
     return ret;
 }
@@ -1008,7 +1272,14 @@ bool atapi_update_presence(struct IDEUnit *unit, bool present) {
     if (present && unit->mediumPresent == false) {
         unit->changeCount++;
         unit->mediumPresent = true;
+        if (unit->medium) {
+            unit->medium->tocLength = 0;
+            unit->medium->written   = false;
+            unit->medium->tocFailed = false;
+        }
         atapi_get_capacity(unit);
+        if (unit->deviceType == DG_CDROM) atapi_medium_toc(unit);
+        cache_media_change(unit);
         ret = true;
     } else if (!present && unit->mediumPresent == true) {
         unit->changeCount++;
@@ -1016,6 +1287,11 @@ bool atapi_update_presence(struct IDEUnit *unit, bool present) {
         unit->logicalSectors = 0;
         unit->blockShift     = 0;
         unit->blockSize      = 0;
+        if (unit->medium) {
+            unit->medium->tocLength = 0;
+            unit->medium->tocFailed = false;
+        }
+        cache_media_change(unit);
         ret = true;
     }
     return ret;
@@ -1080,7 +1356,7 @@ BYTE atapi_read_toc(struct IDEUnit *unit, BYTE *buf, ULONG bufSize) {
         return IOERR_BADADDRESS;
     }
 
-    struct SCSICmd *cmd = MakeSCSICmd(SZ_CDB_10);
+    struct SCSICmd *cmd = atapi_get_cmd(unit,SZ_CDB_10);
 
     if (cmd == NULL) return TDERR_NoMem;
 
@@ -1094,11 +1370,163 @@ BYTE atapi_read_toc(struct IDEUnit *unit, BYTE *buf, ULONG bufSize) {
 
     ret = atapi_packet(cmd,unit) != 0;
 
-    DeleteSCSICmd(cmd);
+    atapi_put_cmd(unit,cmd);
+
+    return ret;
+}
+
+/**
+ * atapi_medium_toc
+ *
+ * Read the TOC into the medium descriptor unless it already holds the TOC of this medium
+ * A failed read is not retried until the next medium
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @returns non-zero on error
+*/
+BYTE atapi_medium_toc(struct IDEUnit *unit) {
+    struct ATAPIMedium *medium = unit->medium;
+    ULONG length;
+    BYTE ret;
+
+    if (medium == NULL) return TDERR_NoMem;
+    if (medium->tocLength > 0) return 0;
+    if (medium->written || medium->tocFailed || !unit->mediumPresent) return TDERR_DiskChanged;
+
+    if ((ret = atapi_read_toc(unit,(BYTE *)&medium->toc,SCSI_TOC_SIZE)) == 0) {
+        length = medium->toc.length + 2;
+        if (length > SCSI_TOC_SIZE) length = SCSI_TOC_SIZE;
+
+        // At least one track and the lead-out
+        if (length >= 4 + 2 * sizeof(struct SCSI_TOC_TRACK_DESCRIPTOR)) {
+            medium->tocLength = length;
+        } else {
+            ret = IOERR_BADLENGTH;
+        }
+    }
+
+    if (ret != 0) medium->tocFailed = true;
 
     return ret;
 }
 
+/**
+ * atapi_reply
+ *
+ * Copy part of a response into the data buffer of a SCSI command, dropping what doesn't fit
+ *
+ * @param data Response buffer of the command
+ * @param limit Bytes the command accepts
+ * @param pos Offset of this part in the response
+ * @param src Pointer to the part
+ * @param len Size of the part
+*/
+static void atapi_reply(UBYTE *data, ULONG limit, ULONG pos, UBYTE *src, ULONG len) {
+    for (ULONG i = 0; i < len && pos + i < limit; i++) {
+        data[pos + i] = src[i];
+    }
+}
+
+/**
+ * atapi_scsi_read_toc
+ *
+ * Answer a SCSI direct READ TOC from the medium descriptor
+ * Only the TOC format (0) is handled, in MSF or LBA form from any starting track
+ *
+ * @param cmd Pointer to a SCSICmd struct for a READ TOC command
+ * @param unit Pointer to an IDEUnit struct
+ * @returns true if the command was answered, false if it has to go to the drive
+*/
+bool atapi_scsi_read_toc(struct SCSICmd *cmd, struct IDEUnit *unit) {
+    struct SCSI_CD_TOC *toc;
+    struct SCSI_TOC_TRACK_DESCRIPTOR *td;
+    UBYTE *cdb   = cmd->scsi_Command;
+    UBYTE *data  = (UBYTE *)cmd->scsi_Data;
+    UBYTE buf[8];
+    ULONG lba, length, limit;
+    UBYTE start;
+    bool  msf;
+    int first, count;
+
+    if (unit->medium == NULL || cmd->scsi_CmdLength < SZ_CDB_10) return false;
+
+    limit = (cdb[7] << 8) | cdb[8];
+    start = cdb[6];
+    msf   = (cdb[1] & 0x02) ? true : false;
+
+    if ((cdb[2] & 0x0F) != 0 || (cdb[9] & 0xC0) != 0 || start > 0xAA) return false;
+    if (data == NULL && limit > 0) return false;
+    if (atapi_medium_toc(unit) != 0) return false;
+
+    if (limit > cmd->scsi_Length) limit = cmd->scsi_Length;
+
+    toc   = &unit->medium->toc;
+    count = (unit->medium->tocLength - 4) / sizeof(struct SCSI_TOC_TRACK_DESCRIPTOR);
+
+    // The drive rejects a starting track past the last one, the lead-out aside
+    if (start > toc->lastTrack && start != 0xAA) return false;
+
+    for (first = 0; first < count && toc->td[first].trackNumber < start; first++);
+
+    length = 2 + (count - first) * sizeof(struct SCSI_TOC_TRACK_DESCRIPTOR);
+
+    buf[0] = length >> 8;
+    buf[1] = length & 0xFF;
+    buf[2] = toc->firstTrack;
+    buf[3] = toc->lastTrack;
+    atapi_reply(data,limit,0,buf,4);
+
+    for (int t = first; t < count; t++) {
+        td = &toc->td[t];
+        buf[0] = 0;
+        buf[1] = td->adrControl;
+        buf[2] = td->trackNumber;
+        buf[3] = 0;
+        if (msf) {
+            buf[4] = 0;
+            buf[5] = td->minute;
+            buf[6] = td->second;
+            buf[7] = td->frame;
+        } else {
+            lba = ((td->minute * 60 + td->second) * 75 + td->frame) - 150;
+            buf[4] = lba >> 24;
+            buf[5] = lba >> 16;
+            buf[6] = lba >> 8;
+            buf[7] = lba;
+        }
+        atapi_reply(data,limit,4 + (t - first) * sizeof(struct SCSI_TOC_TRACK_DESCRIPTOR),buf,sizeof(buf));
+    }
+
+    length += 2;
+    cmd->scsi_Actual = (length < limit) ? length : limit;
+    return true;
+}
+
+/**
+ * atapi_scsi_read_capacity
+ *
+ * Answer a SCSI direct READ CAPACITY (10) from the unit geometry read when the medium appeared
+ *
+ * @param cmd Pointer to a SCSICmd struct for a READ CAPACITY command
+ * @param unit Pointer to an IDEUnit struct
+ * @returns true if the command was answered, false if it has to go to the drive
+*/
+bool atapi_scsi_read_capacity(struct SCSICmd *cmd, struct IDEUnit *unit) {
+    struct SCSI_CAPACITY_10 capacity;
+
+    if (unit->medium == NULL || unit->medium->written) return false;
+    if (!unit->mediumPresent || unit->logicalSectors == 0 || unit->blockSize == 0) return false;
+    if (cmd->scsi_Data == NULL || cmd->scsi_Length < sizeof(capacity)) return false;
+
+    capacity.lba        = unit->logicalSectors - 1;
+    capacity.block_size = unit->blockSize;
+
+    atapi_reply((UBYTE *)cmd->scsi_Data,sizeof(capacity),0,(UBYTE *)&capacity,sizeof(capacity));
+
+    cmd->scsi_Actual = sizeof(capacity);
+    return true;
+}
+
 /**
  *  atapi_get_track_msf
  *
@@ -1143,12 +1571,16 @@ BYTE atapi_play_track_index(struct IDEUnit *unit, UBYTE start, UBYTE end) {
     struct ExecBase *SysBase = unit->SysBase;
     BYTE ret = 0;
     struct SCSI_TRACK_MSF startmsf, endmsf;
+    struct SCSI_CD_TOC *toc;
 
-    struct SCSI_CD_TOC *toc = AllocMem(SCSI_TOC_SIZE,MEMF_ANY|MEMF_CLEAR);
-
-    if (toc == NULL) return TDERR_NoMem;
+    if (atapi_medium_toc(unit) == 0) {
+        toc = &unit->medium->toc;
+    } else {
+        // No TOC kept for this medium, read it just for this command
+        if ((toc = AllocMem(SCSI_TOC_SIZE,MEMF_ANY|MEMF_CLEAR)) == NULL) return TDERR_NoMem;
 
-    ret = atapi_read_toc(unit,(BYTE *)toc,SCSI_TOC_SIZE);
+        ret = atapi_read_toc(unit,(BYTE *)toc,SCSI_TOC_SIZE);
+    }
 
     if (ret == 0) {
 
@@ -1166,7 +1598,7 @@ BYTE atapi_play_track_index(struct IDEUnit *unit, UBYTE start, UBYTE end) {
 
     }
 
-    FreeMem(toc,SCSI_TOC_SIZE);
+    if (unit->medium == NULL || toc != &unit->medium->toc) FreeMem(toc,SCSI_TOC_SIZE);
     return ret;
 }
 
@@ -1183,7 +1615,7 @@ BYTE atapi_play_track_index(struct IDEUnit *unit, UBYTE start, UBYTE end) {
 BYTE atapi_play_audio_msf(struct IDEUnit *unit, struct SCSI_TRACK_MSF *start, struct SCSI_TRACK_MSF *end) {
     BYTE ret = 0;
 
-    struct SCSICmd *cmd = MakeSCSICmd(SZ_CDB_10);
+    struct SCSICmd *cmd = atapi_get_cmd(unit,SZ_CDB_10);
 
     if (cmd == NULL) return TDERR_NoMem;
 
@@ -1202,7 +1634,7 @@ BYTE atapi_play_audio_msf(struct IDEUnit *unit, struct SCSI_TRACK_MSF *start, st
 
     ret = atapi_packet(cmd,unit);
 
-    DeleteSCSICmd(cmd);
+    atapi_put_cmd(unit,cmd);
 
     return ret;
 }
@@ -1242,7 +1674,7 @@ BYTE atapi_translate_play_audio_index(struct SCSICmd *cmd, struct IDEUnit *unit)
 */
 BYTE atapi_autosense(struct SCSICmd *scsi_command, struct IDEUnit *unit) {
     UBYTE ret = 0;
-    struct SCSICmd *cmd = MakeSCSICmd(SZ_CDB_12);
+    struct SCSICmd *cmd = atapi_get_cmd(unit,SZ_CDB_12);
 
     if (cmd != NULL) {
         cmd->scsi_Command[0] = SCSI_CMD_REQUEST_SENSE;
@@ -1254,7 +1686,7 @@ BYTE atapi_autosense(struct SCSICmd *scsi_command, struct IDEUnit *unit) {
 
         ret = atapi_packet(cmd,unit);
         scsi_command->scsi_SenseActual = cmd->scsi_Actual;
-        DeleteSCSICmd(cmd);
+        atapi_put_cmd(unit,cmd);
 
         return ret;
     } else {
@@ -28,11 +28,29 @@
 #define ATAPI_BSY_WAIT_S 5
 #define ATAPI_BSY_WAIT_COUNT (ATAPI_BSY_WAIT_S * 1000 * (1000 / ATAPI_BSY_WAIT_LOOP_US))
 
+#define ATAPI_CMD_SLOTS    3  // Command blocks per unit, a command plus the REQUEST SENSE and READ CAPACITY it may lead to
+#define ATAPI_SENSE_LENGTH 18 // Fixed format sense data returned by REQUEST SENSE
+
+#define ATAPI_XFER_MAX_BYTES 131072 // Largest READ/WRITE command issued by atapi_translate, must be a power of 2
+#define ATAPI_BYTE_COUNT_MAX 0xF800 // Byte count limit per DRQ block, whole 512 and 2048 byte blocks so they all take the fast path
+
 #define IR_PIO_W   0x0
 #define IR_COMMAND 0x1
 #define IR_PIO_R   0x2
 #define IR_STATUS  0x3
 
+#define ATAPI_EVENT_CLASS_MEDIA  0x10 // GET EVENT STATUS NOTIFICATION class request bits
+#define ATAPI_MEDIA_EVENT_NONE   0x00
+#define ATAPI_MEDIA_EVENT_NEW    0x02 // New media, media removal and media changed follow
+
+void atapi_cmd_pool_init(struct IDEUnit *unit);
+void atapi_cmd_pool_free(struct IDEUnit *unit);
+void atapi_medium_init(struct IDEUnit *unit);
+void atapi_medium_free(struct IDEUnit *unit);
+void atapi_medium_written(struct IDEUnit *unit);
+BYTE atapi_medium_toc(struct IDEUnit *unit);
+bool atapi_scsi_read_toc(struct SCSICmd *cmd, struct IDEUnit *unit);
+bool atapi_scsi_read_capacity(struct SCSICmd *cmd, struct IDEUnit *unit);
 void atapi_dev_reset(struct IDEUnit *unit);
 bool atapi_check_signature(struct IDEUnit *unit);
 bool atapi_identify(struct IDEUnit *unit, UWORD *buffer);
@@ -41,6 +59,7 @@ BYTE atapi_scsi_read_write_6 (struct SCSICmd *cmd, struct IDEUnit *unit);
 BYTE atapi_packet_unaligned(struct SCSICmd *cmd, struct IDEUnit *unit);
 BYTE atapi_packet(struct SCSICmd *cmd, struct IDEUnit *unit);
 BYTE atapi_test_unit_ready(struct IDEUnit *unit);
+BYTE atapi_check_media(struct IDEUnit *unit);
 BYTE atapi_get_capacity(struct IDEUnit *unit);
 BYTE atapi_request_sense(struct IDEUnit *unit, UBYTE *errorCode, UBYTE *senseKey, UBYTE *asc, UBYTE *asq);
 BYTE atapi_mode_sense(struct IDEUnit *unit, BYTE page_code, BYTE subpage_code, UWORD *buffer, UWORD length, UWORD *actual, BOOL dbd);
@@ -70,11 +70,11 @@ static inline void ata_write_long_movem (void *source asm("a0"), void *destinati
 static inline void ata_read_long_move (void *source asm("a0"), void *destination asm("a1")) {
     asm volatile (
         "moveq.l #3,d0          \n\t"
-        ".l1:                   \n\t"
+        "1:                     \n\t"
         ".rept  32              \n\t"
         "move.l (%0),(%1)+      \n\t"
         ".endr                  \n\t"
-        "dbra   d0,.l1"
+        "dbra   d0,1b"
     :
     :"a" (source), "a" (destination)
     :"d0"
@@ -90,16 +90,192 @@ static inline void ata_read_long_move (void *source asm("a0"), void *destination
 static inline void ata_write_long_move (void *source asm("a0"), void *destination asm("a1")) {
     asm volatile (
         "moveq.l #3,d0          \n\t"
-        ".l2:                   \n\t"
+        "1:                     \n\t"
         ".rept  32              \n\t"
         "move.l (%0)+,(%1)      \n\t"
         ".endr                  \n\t"
-        "dbra   d0,.l2"
+        "dbra   d0,1b"
     :
     :"a" (source), "a" (destination)
     :"d0"
     );
 }
 
+/**
+ * ata_read_unaligned_long
+ *
+ * Read a sector to an odd buffer
+ * One byte is stored to make the destination even, each longword read is then rotated so that its
+ * first byte completes the previous longword, which is stored whole. The last three bytes are stored as a word and a byte
+ *
+ * @param source Pointer to drive data port
+ * @param destination Pointer to an odd destination buffer
+*/
+static inline void ata_read_unaligned_long (void *source asm("a0"), void *destination asm("a1")) {
+    register void *src asm("a0") = source;
+    register void *dst asm("a1") = destination;
+
+    asm volatile (
+        "move.l (%0),d0         \n\t"
+        "rol.l  #8,d0           \n\t"
+        "move.b d0,(%1)+        \n\t" // Destination is now even
+        "moveq.l #62,d2         \n\t"
+        "1:                     \n\t"
+        "move.l (%0),d1         \n\t"
+        "rol.l  #8,d1           \n\t"
+        "move.b d1,d0           \n\t"
+        "move.l d0,(%1)+        \n\t"
+        "move.l (%0),d0         \n\t"
+        "rol.l  #8,d0           \n\t"
+        "move.b d0,d1           \n\t"
+        "move.l d1,(%1)+        \n\t"
+        "dbra   d2,1b           \n\t"
+        "move.l (%0),d1         \n\t"
+        "rol.l  #8,d1           \n\t"
+        "move.b d1,d0           \n\t"
+        "move.l d0,(%1)+        \n\t"
+        "swap   d1              \n\t"
+        "move.w d1,(%1)+        \n\t"
+        "swap   d1              \n\t"
+        "lsr.w  #8,d1           \n\t"
+        "move.b d1,(%1)"
+    :"+a" (src), "+a" (dst)
+    :
+    :"d0","d1","d2","memory"
+    );
+}
+
+/**
+ * ata_write_unaligned_long
+ *
+ * Write a sector from an odd buffer
+ * One byte is read to make the source even, each longword read then carries its last byte into the next longword written
+ * The last longword is built from the carried byte and the last three bytes
+ *
+ * @param source Pointer to an odd source buffer
+ * @param destination Pointer to drive data port
+*/
+static inline void ata_write_unaligned_long (void *source asm("a0"), void *destination asm("a1")) {
+    register void *src asm("a0") = source;
+    register void *dst asm("a1") = destination;
+
+    asm volatile (
+        "move.b (%0)+,d0        \n\t" // Source is now even
+        "moveq.l #62,d3         \n\t"
+        "1:                     \n\t"
+        "move.l (%0)+,d1        \n\t"
+        "move.b d1,d2           \n\t"
+        "move.b d0,d1           \n\t"
+        "ror.l  #8,d1           \n\t"
+        "move.l d1,(%1)         \n\t"
+        "move.l (%0)+,d1        \n\t"
+        "move.b d1,d0           \n\t"
+        "move.b d2,d1           \n\t"
+        "ror.l  #8,d1           \n\t"
+        "move.l d1,(%1)         \n\t"
+        "dbra   d3,1b           \n\t"
+        "move.l (%0)+,d1        \n\t"
+        "move.b d1,d2           \n\t"
+        "move.b d0,d1           \n\t"
+        "ror.l  #8,d1           \n\t"
+        "move.l d1,(%1)         \n\t"
+        "move.b d2,d1           \n\t"
+        "lsl.w  #8,d1           \n\t"
+        "move.b (%0)+,d1        \n\t"
+        "swap   d1              \n\t"
+        "move.b (%0)+,d1        \n\t"
+        "lsl.w  #8,d1           \n\t"
+        "move.b (%0)+,d1        \n\t"
+        "move.l d1,(%1)"
+    :"+a" (src), "+a" (dst)
+    :
+    :"d0","d1","d2","d3","memory"
+    );
+}
+
+/**
+ * ata_read_line_move16
+ *
+ * Read a sector using move16 - 68040/68060 only and the data port must be mirrored across 512 bytes
+ * move16 needs a 16-byte aligned destination so the longwords before the first line and after the last are moved with move.l
+ * Buffers that are not longword aligned fall back to ata_read_long_move
+ *
+*/
+static inline void ata_read_line_move16 (void *source asm("a0"), void *destination asm("a1")) {
+    if ((ULONG)destination & 3) {
+        ata_read_long_move(source,destination);
+        return;
+    }
+
+    register void *src asm("a0") = source;
+    register void *dst asm("a1") = destination;
+    ULONG head  = ((-(ULONG)destination) & 15) >> 2; // Longwords before the first line
+    ULONG lines = (head) ? 31 : 32;
+    ULONG tail  = (head) ? 4 - head : 0;
+
+    asm volatile (
+        "bra.s  2f              \n\t"
+        "1:                     \n\t"
+        "move.l (%0),(%1)+      \n\t"
+        "2:                     \n\t"
+        "dbra   %2,1b           \n\t"
+        "bra.s  4f              \n\t"
+        "3:                     \n\t"
+        ".word  0xF620,0x9000   \n\t" // move16 (a0)+,(a1)+
+        "4:                     \n\t"
+        "dbra   %3,3b           \n\t"
+        "bra.s  6f              \n\t"
+        "5:                     \n\t"
+        "move.l (%0),(%1)+      \n\t"
+        "6:                     \n\t"
+        "dbra   %4,5b"
+    :"+a" (src), "+a" (dst), "+d" (head), "+d" (lines), "+d" (tail)
+    :
+    :"memory"
+    );
+}
+
+/**
+ * ata_write_line_move16
+ *
+ * Write a sector using move16 - 68040/68060 only and the data port must be mirrored across 512 bytes
+ * move16 needs a 16-byte aligned source so the longwords before the first line and after the last are moved with move.l
+ * Buffers that are not longword aligned fall back to ata_write_long_move
+ *
+*/
+static inline void ata_write_line_move16 (void *source asm("a0"), void *destination asm("a1")) {
+    if ((ULONG)source & 3) {
+        ata_write_long_move(source,destination);
+        return;
+    }
+
+    register void *src asm("a0") = source;
+    register void *dst asm("a1") = destination;
+    ULONG head  = ((-(ULONG)source) & 15) >> 2; // Longwords before the first line
+    ULONG lines = (head) ? 31 : 32;
+    ULONG tail  = (head) ? 4 - head : 0;
+
+    asm volatile (
+        "bra.s  2f              \n\t"
+        "1:                     \n\t"
+        "move.l (%0)+,(%1)      \n\t"
+        "2:                     \n\t"
+        "dbra   %2,1b           \n\t"
+        "bra.s  4f              \n\t"
+        "3:                     \n\t"
+        ".word  0xF620,0x9000   \n\t" // move16 (a0)+,(a1)+
+        "4:                     \n\t"
+        "dbra   %3,3b           \n\t"
+        "bra.s  6f              \n\t"
+        "5:                     \n\t"
+        "move.l (%0)+,(%1)      \n\t"
+        "6:                     \n\t"
+        "dbra   %4,5b"
+    :"+a" (src), "+a" (dst), "+d" (head), "+d" (lines), "+d" (tail)
+    :
+    :"memory"
+    );
+}
+
 #pragma GCC pop_options
 #endif
\ No newline at end of file
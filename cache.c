@@ -0,0 +1,1200 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/* This file is part of lide.device
+ * Copyright (C) 2023 Matthew Harlum <matt@harlum.net>
+ */
+#ifdef READ_CACHE
+
+#include <exec/memory.h>
+#include <proto/exec.h>
+
+#include "ata.h"
+#include "atapi.h"
+#include "cache.h"
+#include "debug.h"
+#include "device.h"
+
+struct CacheSlot {
+    UBYTE *data;
+    ULONG lba;          // First block held by this slot
+    ULONG lastUse;      // LRU stamp
+    UWORD count;        // Number of valid blocks, 0 if the slot is free
+    bool  prefetched;   // Filled by a prefetch and not read since
+};
+
+struct Prefetch {
+    ULONG lba;
+    ULONG count;
+};
+
+struct ReadCache {
+    UBYTE *data;
+    ULONG dataSize;
+    ULONG slotSize;     // Bytes per slot
+    ULONG nextLba;      // Block following the previous read, for sequential detection
+    ULONG clock;        // LRU clock
+    UWORD numSlots;
+    UWORD slotBlocks;   // Blocks per slot
+    UWORD minFill;      // Blocks read on any miss, 0 to only read ahead for sequential reads
+    UWORD window;       // Current read-ahead window in blocks
+    UWORD changeCount;  // The medium the cached blocks belong to
+    UWORD numPrefetch;  // Pending prefetches, oldest first
+    struct Prefetch prefetch[CACHE_PREFETCH_MAX];
+    struct CacheSlot slots[];
+};
+
+#ifdef WRITE_CACHE
+#define WCACHE_NONE 0xFFFF
+
+struct DirtyBlock {
+    ULONG lba;
+    UWORD next;             // Next block in the hash chain or the free list
+};
+
+struct WriteCache {
+    UBYTE *data;
+    ULONG dataSize;
+    ULONG allocSize;
+    struct SGEntry *sg;     // Scatter/gather list used by cache_flush
+    UWORD *order;           // Dirty blocks sorted by LBA, used by cache_flush
+    UWORD numBlocks;
+    UWORD used;             // Number of dirty blocks
+    UWORD freeList;
+    UWORD age;              // Idle ticks since the first block became dirty
+    UWORD changeCount;      // The medium the dirty blocks belong to
+    UWORD failures;         // Idle flushes that failed in a row
+    UWORD hash[WCACHE_HASH_SIZE];
+    struct DirtyBlock blocks[];
+};
+
+/**
+ * wcache_reset
+ *
+ * Mark all blocks of the write cache clean
+ *
+ * @param wc Pointer to the write cache
+*/
+static void wcache_reset(struct WriteCache *wc) {
+    for (int i = 0; i < WCACHE_HASH_SIZE; i++) {
+        wc->hash[i] = WCACHE_NONE;
+    }
+
+    for (int i = 0; i < wc->numBlocks; i++) {
+        wc->blocks[i].next = i + 1;
+    }
+    wc->blocks[wc->numBlocks - 1].next = WCACHE_NONE;
+
+    wc->freeList = 0;
+    wc->used     = 0;
+    wc->age      = 0;
+    wc->failures = 0;
+}
+
+/**
+ * wcache_init
+ *
+ * Allocate the write-back cache of a unit in Fast RAM
+ *
+ * @param unit Pointer to an IDEUnit struct
+*/
+static void wcache_init(struct IDEUnit *unit) {
+    struct ExecBase *SysBase = unit->SysBase;
+    struct WriteCache *wc;
+    ULONG blocks = WCACHE_BLOCKS;
+    ULONG size   = sizeof(struct WriteCache) + (blocks * (sizeof(struct DirtyBlock) + sizeof(struct SGEntry) + sizeof(UWORD)));
+
+    unit->wcache = NULL;
+
+    if ((wc = AllocMem(size,MEMF_ANY|MEMF_CLEAR)) == NULL)
+        return;
+
+    wc->allocSize = size;
+    wc->dataSize  = blocks << unit->blockShift;
+
+    if ((wc->data = AllocMem(wc->dataSize,MEMF_FAST)) == NULL) {
+        FreeMem(wc,size);
+        return;
+    }
+
+    wc->sg        = (struct SGEntry *)&wc->blocks[blocks];
+    wc->order     = (UWORD *)&wc->sg[blocks];
+    wc->numBlocks = blocks;
+    wcache_reset(wc);
+
+    unit->wcache = wc;
+
+    Info("Write cache: %ld blocks\n",blocks);
+}
+
+/**
+ * wcache_get
+ *
+ * Get the write cache of a unit, dirty blocks of a medium that is gone are dropped
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @returns Pointer to the write cache or NULL
+*/
+static struct WriteCache *wcache_get(struct IDEUnit *unit) {
+    struct WriteCache *wc = unit->wcache;
+
+    if (wc && wc->used > 0 && wc->changeCount != unit->changeCount) {
+        Warn("Medium changed, %ld dirty blocks lost\n",(ULONG)wc->used);
+        wcache_reset(wc);
+    }
+
+    return wc;
+}
+
+/**
+ * wcache_find
+ *
+ * Find the dirty copy of a block
+ *
+ * @param wc Pointer to the write cache
+ * @param lba Block to look for
+ * @returns Index of the block or WCACHE_NONE
+*/
+static UWORD wcache_find(struct WriteCache *wc, ULONG lba) {
+    UWORD i;
+
+    for (i = wc->hash[lba & (WCACHE_HASH_SIZE - 1)]; i != WCACHE_NONE; i = wc->blocks[i].next) {
+        if (wc->blocks[i].lba == lba) break;
+    }
+
+    return i;
+}
+
+/**
+ * wcache_drop
+ *
+ * Discard dirty copies of blocks that are about to be overwritten on the media
+ *
+ * @param wc Pointer to the write cache
+ * @param lba First block
+ * @param count Number of blocks
+*/
+static void wcache_drop(struct WriteCache *wc, ULONG lba, ULONG count) {
+    struct DirtyBlock *db;
+    UWORD *link;
+    UWORD i;
+
+    for (int b = 0; b < WCACHE_HASH_SIZE && wc->used > 0; b++) {
+        link = &wc->hash[b];
+        while ((i = *link) != WCACHE_NONE) {
+            db = &wc->blocks[i];
+            if (db->lba >= lba && db->lba < lba + count) {
+                *link        = db->next;
+                db->next     = wc->freeList;
+                wc->freeList = i;
+                wc->used--;
+            } else {
+                link = &db->next;
+            }
+        }
+    }
+}
+
+/**
+ * wcache_overlay
+ *
+ * Replace blocks just read from the media with their dirty copies
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param buffer Buffer holding the blocks
+ * @param lba First block
+ * @param count Number of blocks
+*/
+static void wcache_overlay(struct IDEUnit *unit, UBYTE *buffer, ULONG lba, ULONG count) {
+    struct ExecBase *SysBase = unit->SysBase;
+    struct WriteCache *wc = wcache_get(unit);
+    UWORD blockShift = unit->blockShift;
+    UWORD i;
+
+    if (wc == NULL || wc->used == 0) return;
+
+    for (; count > 0; count--, lba++, buffer += unit->blockSize) {
+        if ((i = wcache_find(wc,lba)) != WCACHE_NONE) {
+            CopyMem(wc->data + ((ULONG)i << blockShift),buffer,unit->blockSize);
+        }
+    }
+}
+
+/**
+ * cache_flush
+ *
+ * Write all dirty blocks to the media in LBA order
+ * Each run of contiguous blocks is written with a single multi-block command
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @returns error
+*/
+BYTE cache_flush(struct IDEUnit *unit) {
+    struct WriteCache *wc = wcache_get(unit);
+    struct SGEntry *sg;
+    UWORD *order;
+    UWORD blockShift = unit->blockShift;
+    UWORD n = 0;
+    UWORD i, j;
+    ULONG lba;
+    UBYTE *data;
+    BYTE error;
+
+    if (wc == NULL || wc->used == 0) return 0;
+
+    order = wc->order;
+
+    // Insertion sort the dirty blocks by LBA
+    for (int b = 0; b < WCACHE_HASH_SIZE; b++) {
+        for (i = wc->hash[b]; i != WCACHE_NONE; i = wc->blocks[i].next) {
+            lba = wc->blocks[i].lba;
+            for (j = n; j > 0 && wc->blocks[order[j-1]].lba > lba; j--) {
+                order[j] = order[j-1];
+            }
+            order[j] = i;
+            n++;
+        }
+    }
+
+    for (i = 0; i < n; i = j) {
+        lba = wc->blocks[order[i]].lba;
+        sg  = wc->sg;
+        sg->buffer = wc->data + ((ULONG)order[i] << blockShift);
+        sg->count  = 1;
+
+        // Extend the run while the LBAs are contiguous, merging blocks that are adjacent in the buffer too
+        for (j = i + 1; j < n && wc->blocks[order[j]].lba == lba + (j - i); j++) {
+            data = wc->data + ((ULONG)order[j] << blockShift);
+            if ((UBYTE *)sg->buffer + (sg->count << blockShift) == data) {
+                sg->count++;
+            } else {
+                sg++;
+                sg->buffer = data;
+                sg->count  = 1;
+            }
+        }
+
+        if ((error = ata_write_sg(wc->sg,lba,j - i,unit)) != 0) {
+            Warn("Write cache flush failed\n");
+            return error;
+        }
+    }
+
+    wcache_reset(wc);
+
+    return 0;
+}
+
+/**
+ * cache_idle
+ *
+ * Called by the IDE task when its queue is empty and on each idle tick
+ * Flushes dirty blocks once they reach WCACHE_MAX_AGE ticks
+ * A failed flush is retried WCACHE_MAX_AGE ticks later, the blocks are dropped after WCACHE_MAX_RETRIES failures
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param tick true if the idle timer expired
+ * @returns true while the unit holds dirty blocks
+*/
+bool cache_idle(struct IDEUnit *unit, bool tick) {
+    struct WriteCache *wc = wcache_get(unit);
+
+    if (wc == NULL || wc->used == 0) return false;
+
+    if (tick && ++wc->age >= WCACHE_MAX_AGE) {
+        if (cache_flush(unit) != 0) {
+            // Wait another WCACHE_MAX_AGE ticks before trying again, give up on the blocks after a few tries
+            wc->age = 0;
+            if (++wc->failures >= WCACHE_MAX_RETRIES) {
+                Warn("Write cache flush failed, %ld dirty blocks lost\n",(ULONG)wc->used);
+                wcache_reset(wc);
+            }
+        }
+    }
+
+    return (wc->used > 0);
+}
+#endif
+
+#if HCACHE_BLOCKS > 0
+#define HCACHE_NONE 0xFFFFFFFF
+
+struct HotBlock {
+    ULONG lba;
+    ULONG lastUse;      // LRU stamp, 0 if the block is free
+};
+
+struct HotCache {
+    UBYTE *data;
+    ULONG clock;        // LRU clock
+    UWORD changeCount;  // The medium the cached blocks belong to
+    ULONG ghosts[HCACHE_GHOSTS];        // Blocks missed once, admitted if they are read again
+    struct HotBlock blocks[HCACHE_BLOCKS];
+};
+
+/**
+ * hcache_reset
+ *
+ * Drop all blocks and the admission history of the hot block cache
+ *
+ * @param hc Pointer to the hot block cache
+*/
+static void hcache_reset(struct HotCache *hc) {
+    for (int i = 0; i < HCACHE_BLOCKS; i++) {
+        hc->blocks[i].lastUse = 0;
+    }
+    for (int i = 0; i < HCACHE_GHOSTS; i++) {
+        hc->ghosts[i] = HCACHE_NONE;
+    }
+}
+
+/**
+ * hcache_init
+ *
+ * Allocate the hot block cache of a unit
+ * It holds single blocks that are read over and over (root, bitmap and directory blocks)
+ * and is sized on its own, it does not need the read cache
+ *
+ * @param unit Pointer to an IDEUnit struct
+*/
+static void hcache_init(struct IDEUnit *unit) {
+    struct ExecBase *SysBase = unit->SysBase;
+    struct HotCache *hc;
+
+    if ((hc = AllocMem(sizeof(struct HotCache),MEMF_ANY|MEMF_CLEAR)) == NULL)
+        return;
+
+    if ((hc->data = AllocMem((ULONG)HCACHE_BLOCKS << unit->blockShift,MEMF_ANY)) == NULL) {
+        FreeMem(hc,sizeof(struct HotCache));
+        return;
+    }
+
+    hcache_reset(hc);
+    hc->changeCount = unit->changeCount;
+    unit->hcache    = hc;
+}
+
+/**
+ * hcache_free
+ *
+ * Free the hot block cache of a unit
+ *
+ * @param unit Pointer to an IDEUnit struct
+*/
+static void hcache_free(struct IDEUnit *unit) {
+    struct ExecBase *SysBase = unit->SysBase;
+    struct HotCache *hc = unit->hcache;
+
+    if (hc) {
+        FreeMem(hc->data,(ULONG)HCACHE_BLOCKS << unit->blockShift);
+        FreeMem(hc,sizeof(struct HotCache));
+        unit->hcache = NULL;
+    }
+}
+
+/**
+ * hcache_get
+ *
+ * Get the hot block cache of a unit, emptied first if the medium has changed
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @returns Pointer to the hot block cache or NULL if there is none
+*/
+static struct HotCache *hcache_get(struct IDEUnit *unit) {
+    struct HotCache *hc = unit->hcache;
+
+    if (hc && hc->changeCount != unit->changeCount) {
+        hcache_reset(hc);
+        hc->changeCount = unit->changeCount;
+    }
+
+    return hc;
+}
+
+/**
+ * hcache_find
+ *
+ * @param hc Pointer to the hot block cache
+ * @param lba Block to look for
+ * @returns Index of the block or -1 if it is not held
+*/
+static WORD hcache_find(struct HotCache *hc, ULONG lba) {
+    for (int i = 0; i < HCACHE_BLOCKS; i++) {
+        if (hc->blocks[i].lastUse && hc->blocks[i].lba == lba) return i;
+    }
+
+    return -1;
+}
+
+/**
+ * hcache_read
+ *
+ * Serve a small read from the hot block cache
+ * The read is only served if every block of it is held
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param buffer destination buffer
+ * @param lba LBA Address
+ * @param count Number of blocks to transfer
+ * @returns true if the read was served
+*/
+static bool hcache_read(struct IDEUnit *unit, void *buffer, ULONG lba, ULONG count) {
+    struct ExecBase *SysBase = unit->SysBase;
+    struct HotCache *hc = hcache_get(unit);
+    WORD index[HCACHE_MAX_READ];
+
+    if (hc == NULL || count > HCACHE_MAX_READ) return false;
+
+    for (int n = 0; n < count; n++) {
+        if ((index[n] = hcache_find(hc,lba + n)) < 0) {
+            unit->stats.hotMisses += count;
+            return false;
+        }
+    }
+
+    for (int n = 0; n < count; n++, buffer += unit->blockSize) {
+        CopyMem(hc->data + ((ULONG)index[n] << unit->blockShift),buffer,unit->blockSize);
+        hc->blocks[index[n]].lastUse = ++hc->clock;
+    }
+    unit->stats.hotHits += count;
+
+    return true;
+}
+
+/**
+ * hcache_holds
+ *
+ * Check if the hot block cache holds any of the given blocks
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param lba First block
+ * @param count Number of blocks
+ * @returns true if at least one of the blocks is cached
+*/
+static bool hcache_holds(struct IDEUnit *unit, ULONG lba, ULONG count) {
+    struct HotCache *hc = hcache_get(unit);
+
+    if (hc == NULL) return false;
+
+    for (int i = 0; i < HCACHE_BLOCKS; i++) {
+        if (hc->blocks[i].lastUse && hc->blocks[i].lba >= lba && hc->blocks[i].lba < lba + count) return true;
+    }
+
+    return false;
+}
+
+/**
+ * hcache_admit
+ *
+ * Offer the blocks of a small read to the hot block cache
+ * A block is only admitted the second time it misses while still remembered as a ghost,
+ * so blocks that are read once (sequential streams) never push out the hot ones
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param buffer Buffer holding the blocks that were read
+ * @param lba LBA Address
+ * @param count Number of blocks
+*/
+static void hcache_admit(struct IDEUnit *unit, void *buffer, ULONG lba, ULONG count) {
+    struct ExecBase *SysBase = unit->SysBase;
+    struct HotCache *hc = unit->hcache;
+    ULONG *ghost;
+    WORD victim;
+
+    if (hc == NULL || count > HCACHE_MAX_READ) return;
+
+    for (; count > 0; count--, lba++, buffer += unit->blockSize) {
+        if (hcache_find(hc,lba) >= 0) continue;
+
+        ghost = &hc->ghosts[lba & (HCACHE_GHOSTS - 1)];
+        if (*ghost != lba) {
+            *ghost = lba;
+            continue;
+        }
+        *ghost = HCACHE_NONE;
+
+        // Replace the least recently used block, free blocks have the lowest stamp
+        victim = 0;
+        for (int i = 1; i < HCACHE_BLOCKS && hc->blocks[victim].lastUse; i++) {
+            if (hc->blocks[i].lastUse < hc->blocks[victim].lastUse) victim = i;
+        }
+
+        CopyMem(buffer,hc->data + ((ULONG)victim << unit->blockShift),unit->blockSize);
+        hc->blocks[victim].lba     = lba;
+        hc->blocks[victim].lastUse = ++hc->clock;
+    }
+}
+
+/**
+ * hcache_update
+ *
+ * Update the held copies of written blocks, or drop them
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param buffer Buffer holding the new contents of the blocks, NULL to drop them
+ * @param lba LBA Address
+ * @param count Number of blocks
+*/
+static void hcache_update(struct IDEUnit *unit, void *buffer, ULONG lba, ULONG count) {
+    struct ExecBase *SysBase = unit->SysBase;
+    struct HotCache *hc = hcache_get(unit);
+    struct HotBlock *block;
+
+    if (hc == NULL) return;
+
+    if (buffer == NULL && lba == 0 && count >= unit->logicalSectors) {
+        // Any block may have changed (ATA passthrough), forget the admission history too
+        hcache_reset(hc);
+        return;
+    }
+
+    for (int i = 0; i < HCACHE_BLOCKS; i++) {
+        block = &hc->blocks[i];
+        if (block->lastUse && block->lba >= lba && block->lba < lba + count) {
+            if (buffer == NULL) {
+                block->lastUse = 0;
+            } else {
+                CopyMem(buffer + ((block->lba - lba) << unit->blockShift),
+                        hc->data + ((ULONG)i << unit->blockShift),
+                        unit->blockSize);
+            }
+        }
+    }
+}
+
+#else
+
+#define hcache_init(unit)
+#define hcache_free(unit)
+#define hcache_read(unit,buffer,lba,count) false
+#define hcache_holds(unit,lba,count) false
+#define hcache_admit(unit,buffer,lba,count)
+#define hcache_update(unit,buffer,lba,count)
+
+#endif
+
+/**
+ * cache_read_media
+ *
+ * Read blocks from the media, with any dirty copies from the write cache applied
+ *
+ * @param buffer destination buffer
+ * @param lba LBA Address
+ * @param count Number of blocks to transfer
+ * @param unit Pointer to an IDEUnit struct
+ * @returns error
+*/
+static BYTE cache_read_media(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
+    ULONG actual;
+    BYTE error;
+
+    if (unit->atapi)
+        return atapi_translate(buffer,lba,count,&actual,unit,READ);
+
+    if ((error = ata_read(buffer,lba,count,unit)) != 0)
+        return error;
+
+#ifdef WRITE_CACHE
+    wcache_overlay(unit,buffer,lba,count);
+#endif
+    return 0;
+}
+
+/**
+ * cache_init
+ *
+ * Allocate the caches of a unit, the read cache is sized from the largest free block of Fast RAM
+ * No read cache is set up if there is no Fast RAM to spare, the hot block cache has a fixed size
+ * ATAPI units only get a fixed size read-ahead buffer as their block size changes with the medium
+ *
+ * @param unit Pointer to an IDEUnit struct
+*/
+void cache_init(struct IDEUnit *unit) {
+    struct ExecBase *SysBase = unit->SysBase;
+    struct ReadCache *rc;
+    ULONG slotSize = (ULONG)CACHE_SLOT_BLOCKS << unit->blockShift;
+    ULONG slots;
+
+    unit->cache  = NULL;
+    unit->wcache = NULL;
+    unit->hcache = NULL;
+
+    if (unit->atapi) {
+        slotSize = CACHE_ATAPI_SLOT_SIZE;
+        slots    = CACHE_ATAPI_SLOTS;
+
+        if ((AvailMem(MEMF_FAST|MEMF_LARGEST) / CACHE_MEM_DIVISOR) / slotSize < slots) {
+            Info("Not enough Fast RAM for a read-ahead buffer\n");
+            return;
+        }
+    } else {
+        if (unit->blockShift == 0) return;
+
+        hcache_init(unit);
+
+        slots = (AvailMem(MEMF_FAST|MEMF_LARGEST) / CACHE_MEM_DIVISOR) / slotSize;
+
+        if (slots < CACHE_MIN_SLOTS) {
+            Info("Not enough Fast RAM for a cache\n");
+            return;
+        }
+
+        if (slots > CACHE_MAX_SLOTS) slots = CACHE_MAX_SLOTS;
+    }
+
+    if ((rc = AllocMem(sizeof(struct ReadCache) + (slots * sizeof(struct CacheSlot)),MEMF_ANY|MEMF_CLEAR)) == NULL)
+        return;
+
+    rc->dataSize = slots * slotSize;
+
+    if ((rc->data = AllocMem(rc->dataSize,MEMF_FAST)) == NULL) {
+        FreeMem(rc,sizeof(struct ReadCache) + (slots * sizeof(struct CacheSlot)));
+        return;
+    }
+
+    for (int i = 0; i < slots; i++) {
+        rc->slots[i].data = rc->data + (i * slotSize);
+    }
+
+    rc->numSlots    = slots;
+    rc->slotSize    = slotSize;
+    unit->cache     = rc;
+
+    cache_media_change(unit);
+
+    Info("Cache: %ld slots of %ld bytes\n",slots,slotSize);
+
+#ifdef WRITE_CACHE
+    if (!unit->atapi) wcache_init(unit);
+#endif
+}
+
+/**
+ * cache_free
+ *
+ * Free the caches of the unit
+ * Dirty blocks must have been flushed with cache_flush first
+ *
+ * @param unit Pointer to an IDEUnit struct
+*/
+void cache_free(struct IDEUnit *unit) {
+    struct ExecBase *SysBase = unit->SysBase;
+    struct ReadCache *rc = unit->cache;
+
+    if (rc) {
+        FreeMem(rc->data,rc->dataSize);
+        FreeMem(rc,sizeof(struct ReadCache) + (rc->numSlots * sizeof(struct CacheSlot)));
+        unit->cache = NULL;
+    }
+
+    hcache_free(unit);
+
+#ifdef WRITE_CACHE
+    struct WriteCache *wc = unit->wcache;
+
+    if (wc) {
+        FreeMem(wc->data,wc->dataSize);
+        FreeMem(wc,wc->allocSize);
+        unit->wcache = NULL;
+    }
+#endif
+}
+
+/**
+ * cache_drop
+ *
+ * Drop all read cache slots that hold any of the given blocks
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param lba First block
+ * @param count Number of blocks
+*/
+static void cache_drop(struct IDEUnit *unit, ULONG lba, ULONG count) {
+    struct ReadCache *rc = unit->cache;
+    struct CacheSlot *slot;
+
+    if (rc == NULL) return;
+
+    for (int i = 0; i < rc->numSlots; i++) {
+        slot = &rc->slots[i];
+        if (slot->count && slot->lba < lba + count && lba < slot->lba + slot->count) {
+            slot->count = 0;
+        }
+    }
+}
+
+/**
+ * cache_invalidate
+ *
+ * Drop all cached copies of the given blocks
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param lba First block
+ * @param count Number of blocks
+*/
+void cache_invalidate(struct IDEUnit *unit, ULONG lba, ULONG count) {
+    cache_drop(unit,lba,count);
+    hcache_update(unit,NULL,lba,count);
+}
+
+/**
+ * cache_media_change
+ *
+ * Empty the read cache for a new medium and size its slots in blocks of that medium
+ * Removable units take a slot on every miss as each command pays for a packet handshake and maybe a seek
+ *
+ * @param unit Pointer to an IDEUnit struct
+*/
+void cache_media_change(struct IDEUnit *unit) {
+    struct ReadCache *rc = unit->cache;
+    ULONG blocks;
+
+    if (rc == NULL) return;
+
+    for (int i = 0; i < rc->numSlots; i++) {
+        rc->slots[i].count = 0;
+    }
+
+    blocks = (unit->blockShift) ? rc->slotSize >> unit->blockShift : 0;
+
+    rc->slotBlocks  = blocks;
+    rc->minFill     = (unit->atapi) ? blocks : 0;
+    rc->window      = 0;
+    rc->nextLba     = 0;
+    rc->numPrefetch = 0;
+    rc->changeCount = unit->changeCount;
+}
+
+/**
+ * cache_lookup
+ *
+ * Find the slot holding a block
+ *
+ * @param rc Pointer to the cache
+ * @param lba Block to look for
+ * @param next Set to the lowest cached block above lba if it is below *next
+ * @returns Pointer to the slot or NULL on a miss
+*/
+static struct CacheSlot *cache_lookup(struct ReadCache *rc, ULONG lba, ULONG *next) {
+    struct CacheSlot *slot;
+
+    for (int i = 0; i < rc->numSlots; i++) {
+        slot = &rc->slots[i];
+        if (slot->count == 0) continue;
+
+        if (lba >= slot->lba && lba < slot->lba + slot->count) {
+            return slot;
+        }
+        if (slot->lba > lba && slot->lba < *next) {
+            *next = slot->lba;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * cache_fill
+ *
+ * Read blocks into the least recently used slot
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param lba First block
+ * @param count Number of blocks, at most a slot
+ * @param filled Set to the slot
+ * @returns error, the slot is left empty
+*/
+static BYTE cache_fill(struct IDEUnit *unit, ULONG lba, ULONG count, struct CacheSlot **filled) {
+    struct ReadCache *rc = unit->cache;
+    struct CacheSlot *slot = &rc->slots[0];
+    BYTE error;
+
+    for (int i = 1; i < rc->numSlots && slot->count; i++) {
+        if (rc->slots[i].count == 0 || rc->slots[i].lastUse < slot->lastUse) {
+            slot = &rc->slots[i];
+        }
+    }
+
+    slot->count      = 0;
+    slot->prefetched = false;
+
+    if ((error = cache_read_media(slot->data,lba,count,unit)) != 0) {
+        return error;
+    }
+
+    slot->lba     = lba;
+    slot->count   = count;
+    slot->lastUse = ++rc->clock;
+    *filled       = slot;
+
+    return 0;
+}
+
+/**
+ * cache_track
+ *
+ * Follow the access pattern, sequential reads grow the read-ahead window up to a slot, random reads collapse it
+ *
+ * @param rc Pointer to the read cache
+ * @param lba First block of the read
+ * @param count Number of blocks
+*/
+static void cache_track(struct ReadCache *rc, ULONG lba, ULONG count) {
+    if (lba == rc->nextLba) {
+        rc->window = (rc->window == 0) ? CACHE_MIN_WINDOW : rc->window << 1;
+        if (rc->window > rc->slotBlocks) rc->window = rc->slotBlocks;
+    } else {
+        rc->window = 0;
+    }
+    rc->nextLba = lba + count;
+}
+
+/**
+ * cache_read_blocks
+ *
+ * Read blocks through the read cache
+ * Sequential reads grow the read-ahead window up to a slot, random reads collapse it
+ *
+ * @param buffer destination buffer
+ * @param lba LBA Address
+ * @param count Number of blocks to transfer
+ * @param unit Pointer to an IDEUnit struct
+ * @returns error
+*/
+static BYTE cache_read_blocks(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
+    struct ExecBase *SysBase = unit->SysBase;
+    struct ReadCache *rc = unit->cache;
+    struct CacheSlot *slot;
+    UWORD blockShift = unit->blockShift;
+    ULONG next, n, ahead;
+    BYTE error;
+
+    if (rc == NULL) return cache_read_media(buffer,lba,count,unit);
+
+    if (rc->changeCount != unit->changeCount) cache_media_change(unit);
+
+    cache_track(rc,lba,count);
+
+    while (count > 0) {
+        next = lba + count;
+
+        if ((slot = cache_lookup(rc,lba,&next)) != NULL) {
+            // Hit
+            n = slot->lba + slot->count - lba;
+            if (n > count) n = count;
+
+            CopyMem(slot->data + ((lba - slot->lba) << blockShift),buffer,n << blockShift);
+            slot->lastUse    = ++rc->clock;
+            slot->prefetched = false;
+            unit->stats.cacheHits += n;
+        } else {
+            // Miss, read up to the next cached block plus the read-ahead window
+            n = next - lba;
+
+            ahead = 0;
+            if (next == lba + count) {
+                ahead = rc->window;
+                if (n + ahead < rc->minFill) ahead = rc->minFill - n;
+            }
+            if (next + ahead > unit->logicalSectors) ahead = unit->logicalSectors - next;
+
+            if (n + ahead <= rc->slotBlocks) {
+                if ((error = cache_fill(unit,lba,n + ahead,&slot)) == 0) {
+                    CopyMem(slot->data,buffer,n << blockShift);
+                } else if (ahead > 0) {
+                    // A block past the request may be unreadable (run-out blocks, a bad sector), read just the request
+                    rc->window = 0;
+                    if ((error = cache_read_media(buffer,lba,n,unit)) != 0) return error;
+                } else {
+                    return error;
+                }
+            } else {
+                if ((error = cache_read_media(buffer,lba,n,unit)) != 0) return error;
+
+                // A failed read-ahead only leaves the slot empty
+                if (ahead > 0) cache_fill(unit,next,(ahead > rc->slotBlocks) ? rc->slotBlocks : ahead,&slot);
+            }
+            unit->stats.cacheMisses += n;
+        }
+
+        buffer += n << blockShift;
+        lba    += n;
+        count  -= n;
+    }
+
+    return 0;
+}
+
+/**
+ * cache_read
+ *
+ * Read blocks through the caches
+ * Small reads are served from the hot block cache when it holds all of their blocks
+ *
+ * @param buffer destination buffer
+ * @param lba LBA Address
+ * @param count Number of blocks to transfer
+ * @param unit Pointer to an IDEUnit struct
+ * @returns error
+*/
+BYTE cache_read(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
+    BYTE error;
+
+    if (hcache_read(unit,buffer,lba,count)) return 0;
+
+    if ((error = cache_read_blocks(buffer,lba,count,unit)) == 0)
+        hcache_admit(unit,buffer,lba,count);
+
+    return error;
+}
+
+/**
+ * cache_write_blocks
+ *
+ * Write blocks and drop any copies of them from the read cache
+ * With the write-back cache the blocks are only copied to it, large writes go straight to the media
+ *
+ * @param buffer source buffer
+ * @param lba LBA Address
+ * @param count Number of blocks to transfer
+ * @param unit Pointer to an IDEUnit struct
+ * @returns error
+*/
+static BYTE cache_write_blocks(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
+    cache_drop(unit,lba,count);
+
+#ifdef WRITE_CACHE
+    struct ExecBase *SysBase = unit->SysBase;
+    struct WriteCache *wc = wcache_get(unit);
+    BYTE error;
+    UWORD i;
+
+    if (wc != NULL) {
+        if (count > (wc->numBlocks >> 1)) {
+            wcache_drop(wc,lba,count);
+        } else {
+            if (wc->used + count > wc->numBlocks && (error = cache_flush(unit)) != 0)
+                return error;
+
+            if (wc->used == 0) {
+                wc->age         = 0;
+                wc->changeCount = unit->changeCount;
+            }
+
+            for (; count > 0; count--, lba++, buffer += unit->blockSize) {
+                if ((i = wcache_find(wc,lba)) == WCACHE_NONE) {
+                    i = wc->freeList;
+                    wc->freeList       = wc->blocks[i].next;
+                    wc->blocks[i].lba  = lba;
+                    wc->blocks[i].next = wc->hash[lba & (WCACHE_HASH_SIZE - 1)];
+                    wc->hash[lba & (WCACHE_HASH_SIZE - 1)] = i;
+                    wc->used++;
+                }
+                CopyMem(buffer,wc->data + ((ULONG)i << unit->blockShift),unit->blockSize);
+            }
+            return 0;
+        }
+    }
+#endif
+
+    if (unit->atapi) {
+        ULONG actual;
+        return atapi_translate(buffer,lba,count,&actual,unit,WRITE);
+    }
+
+    return ata_write(buffer,lba,count,unit);
+}
+
+/**
+ * cache_write
+ *
+ * Write blocks through the caches, the hot block cache is updated write-through
+ *
+ * @param buffer source buffer
+ * @param lba LBA Address
+ * @param count Number of blocks to transfer
+ * @param unit Pointer to an IDEUnit struct
+ * @returns error
+*/
+BYTE cache_write(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit) {
+    BYTE error = cache_write_blocks(buffer,lba,count,unit);
+
+    hcache_update(unit,(error == 0) ? buffer : NULL,lba,count);
+
+    return error;
+}
+
+/**
+ * cache_read_sg
+ *
+ * Read contiguous blocks through the cache into a list of buffers
+ *
+ * @param sg Buffers to fill in order, their counts must add up to count
+ * @param lba LBA Address
+ * @param count Number of blocks to transfer
+ * @param unit Pointer to an IDEUnit struct
+ * @returns error
+*/
+BYTE cache_read_sg(struct SGEntry *sg, ULONG lba, ULONG count, struct IDEUnit *unit) {
+    struct ReadCache *rc = unit->cache;
+    ULONG next = lba + count;
+    BYTE error;
+
+    if (rc && rc->changeCount != unit->changeCount) cache_media_change(unit);
+
+    if (!unit->atapi && (rc == NULL || cache_lookup(rc,lba,&next) == NULL) && next == lba + count &&
+        !hcache_holds(unit,lba,count))
+    {
+        // Nothing of the run is cached, read all of it with one command
+        if ((error = ata_read_sg(sg,lba,count,unit)) != 0) return error;
+
+        if (rc) {
+            cache_track(rc,lba,count);
+            unit->stats.cacheMisses += count;
+        }
+
+        for (; count > 0; count -= sg->count, lba += sg->count, sg++) {
+#ifdef WRITE_CACHE
+            wcache_overlay(unit,sg->buffer,lba,sg->count);
+#endif
+            hcache_admit(unit,sg->buffer,lba,sg->count);
+        }
+        return 0;
+    }
+
+    // Each entry follows the previous one so the read-ahead window keeps growing
+    for (; count > 0; count -= sg->count, lba += sg->count, sg++) {
+        if ((error = cache_read(sg->buffer,lba,sg->count,unit)) != 0) return error;
+    }
+
+    return 0;
+}
+
+/**
+ * cache_write_sg
+ *
+ * Write contiguous blocks from a list of buffers through the caches
+ *
+ * @param sg Buffers to write in order, their counts must add up to count
+ * @param lba LBA Address
+ * @param count Number of blocks to transfer
+ * @param unit Pointer to an IDEUnit struct
+ * @returns error
+*/
+BYTE cache_write_sg(struct SGEntry *sg, ULONG lba, ULONG count, struct IDEUnit *unit) {
+    BYTE error;
+
+    cache_drop(unit,lba,count);
+
+#ifdef WRITE_CACHE
+    struct WriteCache *wc = wcache_get(unit);
+
+    if (wc != NULL) {
+        if (count <= (wc->numBlocks >> 1)) {
+            for (; count > 0; count -= sg->count, lba += sg->count, sg++) {
+                if ((error = cache_write(sg->buffer,lba,sg->count,unit)) != 0) return error;
+            }
+            return 0;
+        }
+        wcache_drop(wc,lba,count);
+    }
+#endif
+
+    error = ata_write_sg(sg,lba,count,unit);
+
+    for (; count > 0; count -= sg->count, lba += sg->count, sg++) {
+        hcache_update(unit,(error == 0) ? sg->buffer : NULL,lba,sg->count);
+    }
+
+    return error;
+}
+
+/**
+ * cache_prefetch
+ *
+ * Queue blocks to be read into the cache once the IDE task has no requests waiting
+ * The oldest pending range is dropped to make room for a new one
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param lba First block
+ * @param count Number of blocks
+*/
+void cache_prefetch(struct IDEUnit *unit, ULONG lba, ULONG count) {
+    struct ReadCache *rc = unit->cache;
+
+    if (rc == NULL || count == 0) return;
+
+    if (rc->numPrefetch == CACHE_PREFETCH_MAX) {
+        for (int i = 1; i < CACHE_PREFETCH_MAX; i++) {
+            rc->prefetch[i-1] = rc->prefetch[i];
+        }
+        rc->numPrefetch--;
+    }
+
+    rc->prefetch[rc->numPrefetch].lba   = lba;
+    rc->prefetch[rc->numPrefetch].count = count;
+    rc->numPrefetch++;
+}
+
+/**
+ * cache_prefetch_step
+ *
+ * Read up to a slot of the oldest pending prefetch, blocks already cached are skipped
+ * All pending prefetches are dropped once half of the slots hold prefetched blocks that have not been read yet
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @returns true while prefetches are pending
+*/
+bool cache_prefetch_step(struct IDEUnit *unit) {
+    struct ReadCache *rc = unit->cache;
+    struct Prefetch *pf;
+    struct CacheSlot *slot;
+    UWORD unread = 0;
+    ULONG next, n;
+
+    if (rc == NULL || rc->numPrefetch == 0) return false;
+
+    if (rc->changeCount != unit->changeCount) {
+        cache_media_change(unit);
+        return false;
+    }
+
+    for (int i = 0; i < rc->numSlots; i++) {
+        if (rc->slots[i].count && rc->slots[i].prefetched) unread++;
+    }
+
+    if (unread >= (rc->numSlots >> 1)) {
+        Trace("Cache full of unread prefetches, dropping %ld\n",(ULONG)rc->numPrefetch);
+        rc->numPrefetch = 0;
+        return false;
+    }
+
+    pf   = &rc->prefetch[0];
+    next = pf->lba + pf->count;
+
+    if ((slot = cache_lookup(rc,pf->lba,&next)) != NULL) {
+        n = slot->lba + slot->count - pf->lba;
+    } else {
+        n = next - pf->lba;
+        if (n > rc->slotBlocks) n = rc->slotBlocks;
+
+        if (cache_fill(unit,pf->lba,n,&slot) == 0) {
+            slot->prefetched = true;
+        } else {
+            n = pf->count; // Give up on a range that fails to read
+        }
+    }
+
+    if (n > pf->count) n = pf->count;
+    pf->lba   += n;
+    pf->count -= n;
+
+    if (pf->count == 0) {
+        for (int i = 1; i < rc->numPrefetch; i++) {
+            rc->prefetch[i-1] = rc->prefetch[i];
+        }
+        rc->numPrefetch--;
+    }
+
+    return (rc->numPrefetch > 0);
+}
+
+#endif
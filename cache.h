@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/* This file is part of lide.device
+ * Copyright (C) 2023 Matthew Harlum <matt@harlum.net>
+ */
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <exec/types.h>
+#include "device.h"
+
+#ifndef CACHE_SLOT_BLOCKS
+#define CACHE_SLOT_BLOCKS 32   // Blocks per cache slot, also the largest read-ahead window
+#endif
+#ifndef CACHE_MIN_SLOTS
+#define CACHE_MIN_SLOTS   4    // Don't bother with a cache smaller than this
+#endif
+#ifndef CACHE_MAX_SLOTS
+#define CACHE_MAX_SLOTS   32   // 32 slots of 32 blocks is 512K for 512 byte blocks
+#endif
+#ifndef CACHE_MEM_DIVISOR
+#define CACHE_MEM_DIVISOR 16   // Use at most this fraction of the largest free block of Fast RAM
+#endif
+#define CACHE_MIN_WINDOW  8    // Read-ahead once a sequential stream is detected, doubles with each request
+#define CACHE_PREFETCH_MAX 4   // Pending CMD_PREFETCH ranges per unit, the oldest is dropped for a new one
+
+#ifndef CACHE_ATAPI_SLOTS
+#define CACHE_ATAPI_SLOTS     4      // Read-ahead buffer of ATAPI units, 128K in all
+#endif
+#define CACHE_ATAPI_SLOT_SIZE 32768  // 16 CD frames, a whole slot is read on every miss
+
+#ifndef WCACHE_BLOCKS
+#define WCACHE_BLOCKS     128  // Dirty blocks held by the write-back cache
+#endif
+#ifndef WCACHE_MAX_AGE
+#define WCACHE_MAX_AGE    40   // Flush dirty blocks after this many idle ticks (about 2 seconds)
+#endif
+#define WCACHE_HASH_SIZE  64   // Must be a power of 2
+#define WCACHE_MAX_RETRIES 3   // Failed idle flushes before the dirty blocks are dropped
+
+#ifndef HCACHE_BLOCKS
+#define HCACHE_BLOCKS     32   // Blocks held by the hot block cache, 0 to disable it
+#endif
+#define HCACHE_MAX_READ   4    // Only reads of at most this many blocks use the hot block cache
+#define HCACHE_GHOSTS     64   // Recently missed blocks remembered for admission, must be a power of 2
+
+#ifdef READ_CACHE
+
+void cache_init(struct IDEUnit *unit);
+void cache_free(struct IDEUnit *unit);
+void cache_invalidate(struct IDEUnit *unit, ULONG lba, ULONG count);
+void cache_media_change(struct IDEUnit *unit);
+BYTE cache_read(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit);
+BYTE cache_write(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit);
+BYTE cache_read_sg(struct SGEntry *sg, ULONG lba, ULONG count, struct IDEUnit *unit);
+BYTE cache_write_sg(struct SGEntry *sg, ULONG lba, ULONG count, struct IDEUnit *unit);
+void cache_prefetch(struct IDEUnit *unit, ULONG lba, ULONG count);
+bool cache_prefetch_step(struct IDEUnit *unit);
+
+#else
+
+#define cache_init(unit)
+#define cache_free(unit)
+#define cache_invalidate(unit,lba,count)
+#define cache_media_change(unit)
+#define cache_read  ata_read
+#define cache_write ata_write
+#define cache_read_sg  ata_read_sg
+#define cache_write_sg ata_write_sg
+#define cache_prefetch(unit,lba,count)
+#define cache_prefetch_step(unit) false
+
+#endif
+
+#ifdef WRITE_CACHE
+
+BYTE cache_flush(struct IDEUnit *unit);
+bool cache_idle(struct IDEUnit *unit, bool tick);
+
+#else
+
+static inline BYTE cache_flush(struct IDEUnit *unit) { return 0; }
+static inline bool cache_idle(struct IDEUnit *unit, bool tick) { return false; }
+
+#endif
+
+#endif
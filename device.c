@@ -418,6 +418,7 @@ struct Library __attribute__((used, saveds)) * init_device(struct ExecBase *SysB
             itask->dev      = dev;
             itask->cd       = cd;
             itask->channel  = c;
+            itask->numChannels = channels;
             itask->taskNum  = dev->numTasks;
             itask->parent   = self;
             itask->boardNum = (numBoards - 1);
@@ -480,6 +481,19 @@ static BPTR __attribute__((used, saveds)) expunge(struct DeviceBase *dev asm("a6
     */
 
     dev->lib.lib_Flags |= LIBF_DELEXP;
+
+#ifdef WRITE_CACHE
+    // Memory is short or the system is going down, have the IDE tasks write back their dirty blocks
+    struct ExecBase *SysBase = dev->SysBase;
+    struct IDETask *itask;
+
+    for (itask = (struct IDETask *)dev->ideTasks.mlh_Head;
+         itask->mn_Node.mln_Succ != NULL;
+         itask = (struct IDETask *)itask->mn_Node.mln_Succ)
+    {
+        if (itask->active && itask->task) Signal(itask->task,IDE_FLUSH_SIGNAL);
+    }
+#endif
     return 0;
 
     // if (dev->lib.lib_OpenCnt != 0)
@@ -693,6 +707,9 @@ const UWORD supported_commands[] =
     NSCMD_TD_WRITE64,
     NSCMD_TD_FORMAT64,
     HD_SCSICMD,
+    CMD_READ_SG,
+    CMD_WRITE_SG,
+    CMD_PREFETCH,
     0
 };
 
@@ -738,8 +755,6 @@ static void __attribute__((used, saveds)) begin_io(struct DeviceBase *dev asm("a
         Trace("Command %lx\n",ioreq->io_Command);
         switch (ioreq->io_Command) {
             case TD_MOTOR:
-            case CMD_CLEAR:
-            case CMD_UPDATE:
                 ioreq->io_Actual = 0;
                 error            = 0;
                 break;
@@ -811,6 +826,12 @@ static void __attribute__((used, saveds)) begin_io(struct DeviceBase *dev asm("a
             case NSCMD_ETD_FORMAT64:
             case CMD_XFER:
             case CMD_PIO:
+            case CMD_MULTIPLE:
+            case CMD_READ_SG:
+            case CMD_WRITE_SG:
+            case CMD_PREFETCH:
+            case CMD_CLEAR:
+            case CMD_UPDATE:
             case HD_SCSICMD:
                 // Send all of these to ide_task
                 ioreq->io_Flags &= ~IOF_QUICK;
@@ -818,6 +839,16 @@ static void __attribute__((used, saveds)) begin_io(struct DeviceBase *dev asm("a
                 Trace((CONST_STRPTR) "IO queued\n");
                 return;
 
+            case CMD_STATS:
+                if (ioreq->io_Length >= sizeof(struct IDEStats)) {
+                    CopyMem(&unit->stats,ioreq->io_Data,sizeof(struct IDEStats));
+                    ioreq->io_Actual = sizeof(struct IDEStats);
+                    error = 0;
+                } else {
+                    error = IOERR_BADLENGTH;
+                }
+                break;
+
             case NSCMD_DEVICEQUERY:
                 if (ioreq->io_Length >= sizeof(struct NSDeviceQueryResult))
                 {
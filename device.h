@@ -15,15 +15,74 @@
 
 #define MAX_UNITS 4
 
+// The SD driver has no ATA interrupt to wait for
+#if defined(SD_DRIVER) && defined(ATA_IRQ)
+#undef ATA_IRQ
+#endif
+
 // VSCode C/C++ extension doesn't like the asm("<reg>") syntax
 #ifdef __INTELLISENSE__
 #define asm(x)
 #endif
 
+#ifndef SD_DRIVER
 enum xfer {
     longword_movem,
-    longword_move
+    longword_move,
+    line_move16         // move16 line transfers for 68040 and up
+};
+#else
+enum xfer {
+    spi_xfer_68000,     // 68000 SPI kernels
+    spi_xfer_68020      // Longword SPI kernels for 68020 and up
+};
+#endif
+
+#define MULTIPLE_STEPS 8    // DRQ block sizes 1,2,4..128 timed by the tuning pass
+
+#define XFER_TICKS_SLOTS     4 // Transfer routines timed by the benchmark, indexed by enum xfer
+#define XFER_TICKS_UNALIGNED 3 // Slot for the odd buffer routine
+
+/**
+ * Unit statistics, returned by CMD_STATS
+ *
+*/
+struct IDEStats {
+    ULONG cacheHits;        // Blocks served from the read cache
+    ULONG cacheMisses;      // Blocks the read cache had to fetch from the medium
+    ULONG hotHits;          // Blocks served from the hot block cache
+    ULONG hotMisses;        // Blocks of small reads the hot block cache did not hold
+    ULONG requestsMerged;   // Requests carried out as part of a transfer for an adjacent request
+    ULONG multipleTicks[MULTIPLE_STEPS]; // E Clock ticks taken by the tuning reads at DRQ block size 1<<n, 0 if not tried
+    ULONG xferTicks[XFER_TICKS_SLOTS];   // E Clock ticks taken by each transfer routine in the benchmark, 0 if not tried
+};
+
+/**
+ * Extent of a CMD_READ_SG / CMD_WRITE_SG request
+ * io_Data points to an array of these and io_Length is the number of entries
+ *
+*/
+struct SGDescriptor {
+    ULONG offsetHigh;       // Upper 32 bits of the byte offset
+    ULONG offset;           // Lower 32 bits of the byte offset
+    ULONG length;           // Bytes to transfer, a multiple of the block size
+    APTR  buffer;
+};
+
+/**
+ * Scatter/gather list entry, a buffer for the next count blocks of a transfer
+ *
+*/
+struct SGEntry {
+    APTR  buffer;
+    ULONG count;
 };
+
+struct ReadCache;
+struct WriteCache;
+struct HotCache;
+struct ATAPICmdPool;
+struct ATAPIMedium;
 
 #ifndef SD_DRIVER
 
@@ -49,7 +108,7 @@ struct IDEUnit {
     struct ExecBase *SysBase;
     struct IDETask *itask;
     struct Drive drive;
-    BYTE  (*write_taskfile)(struct IDEUnit *, UBYTE, ULONG, UBYTE, UBYTE);
+    BYTE  (*write_taskfile)(struct IDEUnit *, UBYTE, ULONG, UWORD, UBYTE);
     enum  xfer xferMethod;
     void  (*read_fast)(void * asm("a0"), void * asm("a1"));
     void  (*write_fast)(void * asm("a0"), void * asm("a1"));
@@ -58,6 +117,7 @@ struct IDEUnit {
     volatile UBYTE *shadowDevHead;
     volatile void  *changeInt;
     volatile bool  deferTUR;
+    volatile bool  active;          // Served a request since the last media poll
     UBYTE unitNum;
     UBYTE channel;
     UBYTE deviceType;
@@ -78,8 +138,20 @@ struct IDEUnit {
     UWORD blockShift;
     ULONG cylinders;
     ULONG logicalSectors;
-    struct MinList changeInts;
-    UBYTE multipleCount;
+    struct MinList changeInts;
+    UBYTE multipleCount;
+    UBYTE multipleMax;              // Largest DRQ block size supported by the drive (IDENTIFY word 47)
+    UBYTE flushCommand;             // FLUSH CACHE (EXT) command for the drive, 0 if it has none
+    bool  writeCache;               // Drive write cache is enabled
+    bool  noEvents;                 // ATAPI drive doesn't report media events, poll it with TEST UNIT READY
+    UBYTE pollInterval;             // Seconds between media polls, grows while nothing changes
+    UBYTE pollCountdown;            // Seconds left until the next media poll
+    struct ATAPICmdPool *cmdPool;   // Command blocks for the packets the driver sends itself
+    struct ATAPIMedium *medium;     // TOC of the loaded disc
+    struct ReadCache *cache;
+    struct WriteCache *wcache;
+    struct HotCache *hcache;
+    struct IDEStats stats;
 };
 
 #else
@@ -93,10 +165,11 @@ struct IDEUnit {
     struct ExecBase *SysBase;
     struct IDETask *itask;
     sd_card_info_t sd_card_info;    // SD card context
-    BYTE  (*write_taskfile)(struct IDEUnit *, UBYTE, ULONG, UBYTE, UBYTE);
+    BYTE  (*write_taskfile)(struct IDEUnit *, UBYTE, ULONG, UWORD, UBYTE);
     volatile UBYTE *shadowDevHead;
     volatile void  *changeInt;
     volatile bool  deferTUR;
+    volatile bool  active;          // Served a request since the last media poll
     UBYTE unitNum;
     UBYTE channel;
     UBYTE deviceType;
@@ -117,6 +190,17 @@ struct IDEUnit {
     ULONG logicalSectors;
     struct MinList changeInts;
     UBYTE multipleCount;
+    enum  xfer xferMethod;
+    UBYTE streamState;              // Open multi-block transfer (sd_stream_t)
+    bool  streamActive;             // Stream used since the last idle tick
+    ULONG streamLba;                // LBA following the last block transferred
+    ULONG streamEnd;                // A write stream is closed at this LBA (AU boundary)
+    UBYTE pollInterval;             // Seconds between media polls, grows while nothing changes
+    UBYTE pollCountdown;            // Seconds left until the next media poll
+    struct ReadCache *cache;
+    struct WriteCache *wcache;
+    struct HotCache *hcache;
+    struct IDEStats stats;
 };
 
 #endif // SD_DRIVER
@@ -146,11 +230,29 @@ struct IDETask {
     struct MsgPort     *iomp;
     struct MsgPort     *timermp;
     struct timerequest *tr;
+    struct MsgPort     *idlemp;
+    struct timerequest *idletr;
+    bool               idleArmed;
+    struct IDEUnit     *headUnit;   // Unit and LBA following the last transfer, for the elevator
+    ULONG              headLba;
+#ifdef SD_DRIVER
+    struct IDEUnit     *streamUnit; // SD unit holding the bus for an open stream
+#endif
+#ifdef ATA_IRQ
+    struct Interrupt   irqServer;
+    volatile UBYTE     *irqStatus;
+    volatile UBYTE     *irqAltStatus; // Also the device control register when written
+    volatile bool      irqWaiting;    // Set while the task sleeps on INTRQ
+    ULONG              irqMask;       // Signal sent by the interrupt server, 0 if not installed
+    BYTE               irqSignal;
+#endif
     volatile bool      active;
     UBYTE              shadowDevHead;
+    WORD               shadowFeatures; // Last value written to the features register, -1 if unknown
     UBYTE              boardNum;
     UBYTE              taskNum;
     UBYTE              channel;
+    UBYTE              numChannels; // Channels on this board
 };
 
 #define STR(s) #s      /* Turn s into a string literal without expanding macro definitions (however, \
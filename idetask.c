@@ -11,6 +11,7 @@
 
 #include "ata.h"
 #include "atapi.h"
+#include "cache.h"
 #include "debug.h"
 #include "device.h"
 #include "idetask.h"
@@ -193,7 +194,15 @@ static BYTE handle_scsi_command(struct IOStdReq *ioreq) {
         // Non-ATAPI drives - Translate SCSI CMD to ATA
         switch (scsi_command->scsi_Command[0]) {
             case SCSI_CMD_ATA_PASSTHROUGH:
-                error = scsi_ata_passthrough(unit,scsi_command);
+                // The command may read or write any block, write back dirty blocks first and drop the cached copies after
+                if ((error = cache_flush(unit)) == 0) {
+                    error = scsi_ata_passthrough(unit,scsi_command);
+                    // The command may have reset the drive (DEVICE RESET, EXECUTE DEVICE DIAGNOSTIC)
+                    unit->itask->shadowFeatures = -1;
+                } else {
+                    scsi_sense(scsi_command,0,0,error);
+                }
+                cache_invalidate(unit,0,unit->logicalSectors);
                 break;
 
             case SCSI_CMD_TEST_UNIT_READY:
@@ -213,6 +222,17 @@ static BYTE handle_scsi_command(struct IOStdReq *ioreq) {
                 error = scsi_read_capaity_ata(unit,scsi_command);
                 break;
 
+            case SCSI_CMD_SYNCHRONIZE_CACHE_10:
+                if ((error = cache_flush(unit)) == 0)
+                    error = ata_flush(unit);
+
+                if (error == 0) {
+                    scsi_command->scsi_Actual = 0;
+                } else {
+                    scsi_sense(scsi_command,0,0,error);
+                }
+                break;
+
             case SCSI_CMD_READ_6:
             case SCSI_CMD_WRITE_6:
                 lba   = (((((struct SCSI_CDB_6 *)command)->lba_high & 0x1F) << 16) |
@@ -237,9 +257,9 @@ static BYTE handle_scsi_command(struct IOStdReq *ioreq) {
                 direction = (scsi_command->scsi_Flags & SCSIF_READ) ? READ : WRITE;
 
                 if (direction == READ) {
-                    error = ata_read(data,lba,count,unit);
+                    error = cache_read(data,lba,count,unit);
                 } else {
-                    error = ata_write(data,lba,count,unit);
+                    error = cache_write(data,lba,count,unit);
                 }
                 if (error == 0) {
                     scsi_command->scsi_Actual = scsi_command->scsi_Length;
@@ -294,13 +314,21 @@ static BYTE handle_scsi_command(struct IOStdReq *ioreq) {
                 error = atapi_translate_play_audio_index(scsi_command,unit);
                 break;
 
+            case SCSI_CMD_READ_TOC:
+                // CD players ask for this over and over, answer from the TOC read when the disc was loaded
+                if (atapi_scsi_read_toc(scsi_command,unit)) break;
+                goto atapi_command;
+
             case SCSI_CMD_READ_CAPACITY_10:
+                if (atapi_scsi_read_capacity(scsi_command,unit)) break;
+
                 // CDROMs don't support parameters for READ_CAPACITY_10 so clear them all
                 for (int i=1; i < scsi_command->scsi_CmdLength; i++) {
                     scsi_command->scsi_Command[i] = 0;
                 }
 
             default:
+    atapi_command:
                 if (!((ULONG)scsi_command->scsi_Data & 0x01)) { // Buffer is word-aligned?
                     error = atapi_packet(scsi_command,unit);
                 } else {
@@ -310,6 +338,18 @@ static BYTE handle_scsi_command(struct IOStdReq *ioreq) {
                 break;
         }
 
+        // Data sent to the drive may have been written to the medium behind the read-ahead buffer
+        // Mode pages (audio volume etc) leave the medium alone
+        if (((scsi_command->scsi_Length > 0 && !(scsi_command->scsi_Flags & SCSIF_READ)) &&
+             scsi_command->scsi_Command[0] != SCSI_CMD_MODE_SELECT_6 &&
+             scsi_command->scsi_Command[0] != SCSI_CMD_MODE_SELECT_10) ||
+            scsi_command->scsi_Command[0] == SCSI_CMD_FORMAT_UNIT ||
+            scsi_command->scsi_Command[0] == SCSI_CMD_CLOSE_TRACK ||
+            scsi_command->scsi_Command[0] == SCSI_CMD_BLANK) {
+            cache_invalidate(unit,0,unit->logicalSectors);
+            atapi_medium_written(unit);
+        }
+
         if (error != 0) {
             if (scsi_command->scsi_Flags & (SCSIF_AUTOSENSE)) {
 
@@ -345,6 +385,7 @@ static BYTE handle_scsi_command(struct IOStdReq *ioreq) {
  * diskchange_task
  *
  * This task periodically polls all removable devices for media changes and updates
+ * Each unit is polled every tick after a change or an eject, backing off to CHANGEINT_MAX_TICKS while nothing happens
 */
 void __attribute__((noreturn)) diskchange_task () {
     struct ExecBase *SysBase = *(struct ExecBase **)4UL;
@@ -353,7 +394,7 @@ void __attribute__((noreturn)) diskchange_task () {
     struct timerequest *TimerReq = NULL;
     struct IOStdReq *ioreq = NULL, *intreq = NULL;
     struct IDEUnit *unit = NULL;
-    bool present;
+    bool present, removable;
 
     while (task->tc_UserData == NULL); // Wait for Task Data to be populated
     struct DeviceBase *dev = (struct DeviceBase *)task->tc_UserData;
@@ -362,7 +403,7 @@ void __attribute__((noreturn)) diskchange_task () {
     if ((iomp = L_CreatePort(NULL,0)) == NULL || (ioreq = L_CreateStdIO(iomp)) == NULL) goto die;
     if (OpenDevice("timer.device",UNIT_VBLANK,(struct IORequest *)TimerReq,0) != 0) goto die;
 
-    ioreq->io_Command = TD_CHANGESTATE; // Run TD_CHANGESTATE to update medium presence, this should be replaced with a TUR call
+    ioreq->io_Command = TD_CHANGESTATE; // Run TD_CHANGESTATE to update medium presence
     ioreq->io_Data    = NULL;
     ioreq->io_Length  = 1;
     ioreq->io_Actual  = 0;
@@ -381,7 +422,23 @@ void __attribute__((noreturn)) diskchange_task () {
              unit->mn_Node.mln_Succ != NULL;
              unit = (struct IDEUnit *)unit->mn_Node.mln_Succ)
         {
-            if (unit->present && unit->atapi && !unit->deferTUR) {
+#ifdef SD_DRIVER
+            removable = unit->present;
+#else
+            removable = unit->present && unit->atapi;
+#endif
+            // A unit that is serving requests has its medium, check again once it goes quiet
+            if (removable && (unit->deferTUR || unit->active)) {
+                unit->pollCountdown = unit->pollInterval;
+                removable = false;
+            }
+
+            if (removable && unit->pollCountdown > 1) {
+                unit->pollCountdown--;
+                removable = false;
+            }
+
+            if (removable) {
                 Trace("Testing unit %ld\n",unit->unitNum);
                 ioreq->io_Unit = (struct Unit *)unit;
 
@@ -406,11 +463,17 @@ void __attribute__((noreturn)) diskchange_task () {
                         }
                     }
                     Permit();
+
+                    unit->pollInterval = 1;
+                } else if (unit->pollInterval < CHANGEINT_MAX_TICKS) {
+                    unit->pollInterval = (unit->pollInterval) ? unit->pollInterval << 1 : 1;
                 }
 
+                unit->pollCountdown     = unit->pollInterval;
                 unit->mediumPresentPrev = present;
             }
             unit->deferTUR = false;
+            unit->active   = false;
         }
 
         ReleaseSemaphore(&dev->ulSem);
@@ -466,6 +529,7 @@ static BYTE init_units(struct IDETask *itask) {
             unit->multipleCount     = 0;
             unit->shadowDevHead     = &itask->shadowDevHead;
             *unit->shadowDevHead    = 0;
+            itask->shadowFeatures   = -1;
             unit->deferTUR          = false;
 
             // Initialize the change int list
@@ -476,7 +540,17 @@ static BYTE init_units(struct IDETask *itask) {
             Warn("testing unit %ld\n",unit->unitNum);
 
             if (ata_init_unit(unit)) {
+#ifdef SD_DRIVER
+                dev->hasRemovables      = true; // Cards can be swapped
+                unit->mediumPresentPrev = true;
+#else
                 if (unit->atapi) dev->hasRemovables = true;
+                if (unit->atapi) {
+                    atapi_cmd_pool_init(unit);
+                    atapi_medium_init(unit);
+                }
+#endif
+                cache_init(unit);
                 num_units++;
                 itask->dev->numUnits++;
                 dev->highestUnit = unit->unitNum;
@@ -495,6 +569,72 @@ static BYTE init_units(struct IDETask *itask) {
     return num_units;
 }
 
+#ifdef IDLE_TIMER
+/**
+ * idle_units
+ *
+ * Let the units of this task close idle SD streams and write back aged dirty blocks
+ * Keeps the idle timer running while any unit has work pending
+ *
+ * @param itask Pointer to an IDETask struct
+ * @param tick true if the idle timer expired
+*/
+static void idle_units(struct IDETask *itask, bool tick) {
+    struct ExecBase *SysBase = itask->dev->SysBase;
+    struct IDEUnit *unit;
+    bool pending = false;
+
+    for (unit = (struct IDEUnit *)itask->dev->units.mlh_Head;
+         unit->mn_Node.mln_Succ != NULL;
+         unit = (struct IDEUnit *)unit->mn_Node.mln_Succ) {
+            if (unit->itask == itask) {
+                if (cache_idle(unit,tick))
+                    pending = true;
+#ifdef SD_DRIVER
+                if (sd_idle(unit,tick))
+                    pending = true;
+#endif
+            }
+         }
+
+    if (pending && !itask->idleArmed) {
+        itask->idletr->tr_node.io_Command = TR_ADDREQUEST;
+        itask->idletr->tr_time.tv_sec     = 0;
+        itask->idletr->tr_time.tv_micro   = IDLE_INTERVAL_US;
+        SendIO((struct IORequest *)itask->idletr);
+        itask->idleArmed = true;
+    }
+}
+#endif
+
+#ifdef READ_CACHE
+/**
+ * prefetch_units
+ *
+ * Carry out the pending prefetches of the units of this task until a request comes in
+ *
+ * @param itask Pointer to an IDETask struct
+*/
+static void prefetch_units(struct IDETask *itask) {
+    struct IDEUnit *unit;
+    bool pending = true;
+
+    while (pending) {
+        pending = false;
+
+        for (unit = (struct IDEUnit *)itask->dev->units.mlh_Head;
+             unit->mn_Node.mln_Succ != NULL;
+             unit = (struct IDEUnit *)unit->mn_Node.mln_Succ) {
+                // Foreground requests always go first
+                if (itask->iomp->mp_MsgList.lh_Head->ln_Succ != NULL) return;
+
+                if (unit->itask == itask && cache_prefetch_step(unit))
+                    pending = true;
+             }
+    }
+}
+#endif
+
 /**
  * cleanup
  *
@@ -502,6 +642,21 @@ static BYTE init_units(struct IDETask *itask) {
 */
 static void cleanup(struct IDETask *itask) {
     struct ExecBase *SysBase = itask->dev->SysBase;
+    struct IDEUnit *unit;
+
+    // Write back anything still cached while the timer is still open
+    for (unit = (struct IDEUnit *)itask->dev->units.mlh_Head;
+         unit->mn_Node.mln_Succ != NULL;
+         unit =  (struct IDEUnit *)unit->mn_Node.mln_Succ) {
+            if (unit->itask == itask) {
+                cache_flush(unit);
+                ata_flush(unit);
+            }
+         }
+
+#ifdef ATA_IRQ
+    ata_irq_free(itask);
+#endif
     if (itask->iomp)
         L_DeletePort(itask->iomp);
 
@@ -513,8 +668,17 @@ static void cleanup(struct IDETask *itask) {
     }
     if (itask->timermp) L_DeletePort(itask->timermp);
 
-    struct IDEUnit *unit;
+    if (itask->idletr) {
+        if (itask->idleArmed) {
+            AbortIO((struct IORequest *)itask->idletr);
+            WaitIO((struct IORequest *)itask->idletr);
+        }
+        if (itask->idletr->tr_node.io_Device)
+            CloseDevice((struct IORequest *)itask->idletr);
 
+        L_DeleteExtIO((struct IORequest *)itask->idletr);
+    }
+    if (itask->idlemp) L_DeletePort(itask->idlemp);
 
     for (unit = (struct IDEUnit *)itask->dev->units.mlh_Head;
          unit->mn_Node.mln_Succ != NULL;
@@ -523,6 +687,11 @@ static void cleanup(struct IDETask *itask) {
                 ObtainSemaphore(&itask->dev->ulSem);
                 Remove((struct Node *)unit);
                 ReleaseSemaphore(&itask->dev->ulSem);
+                cache_free(unit);
+#ifndef SD_DRIVER
+                atapi_cmd_pool_free(unit);
+                atapi_medium_free(unit);
+#endif
                 FreeMem(unit,sizeof(struct IDEUnit));
             }
          }
@@ -533,6 +702,508 @@ static void cleanup(struct IDETask *itask) {
     Signal(itask->parent, SIGF_SINGLE);
 }
 
+/**
+ * An extent of a CMD_READ_SG/CMD_WRITE_SG request in blocks
+ *
+*/
+struct SGExtent {
+    ULONG lba;
+    ULONG count;
+    APTR  buffer;
+};
+
+/**
+ * process_sg
+ *
+ * Carry out the extents of a CMD_READ_SG/CMD_WRITE_SG request in one pass
+ * Up to SG_MAX_EXTENTS descriptors at a time are sorted by LBA and adjacent ones are merged into a single transfer
+ * A write that overlaps an extent already gathered starts the next group so writes land in the order given
+ *
+ * @param ioreq Pointer to the IO Request
+ * @param direction READ or WRITE
+ * @returns error
+*/
+static BYTE process_sg(struct IOStdReq *ioreq, enum xfer_dir direction) {
+    struct IDEUnit *unit = (struct IDEUnit *)ioreq->io_Unit;
+    struct SGDescriptor *desc = ioreq->io_Data;
+    struct SGExtent ext[SG_MAX_EXTENTS];
+    struct SGEntry sg[SG_MAX_EXTENTS];
+    struct SGExtent x;
+    ULONG count, actual;
+    ULONG done = 0;
+    BYTE error;
+    int i, j, n;
+
+    ioreq->io_Actual = 0;
+
+    if (desc == NULL) return IOERR_BADADDRESS;
+
+    if (unit->mediumPresent == false) {
+        Trace("Access attempt without media\n");
+        return TDERR_DiskChanged;
+    }
+
+    for (ULONG d = 0; d < ioreq->io_Length; d += n) {
+        // Gather the next group of extents in LBA order
+        for (n = 0; n < SG_MAX_EXTENTS && d + n < ioreq->io_Length; n++) {
+            x.lba    = (((long long)desc[d+n].offsetHigh << 32 | desc[d+n].offset) >> unit->blockShift);
+            x.count  = desc[d+n].length >> unit->blockShift;
+            x.buffer = desc[d+n].buffer;
+
+            if (x.count == 0) return IOERR_BADLENGTH;
+            if ((x.lba + x.count) > unit->logicalSectors) return IOERR_BADADDRESS;
+
+            if (direction == WRITE) {
+                for (i = 0; i < n; i++) {
+                    if (ext[i].lba < x.lba + x.count && x.lba < ext[i].lba + ext[i].count) break;
+                }
+                if (i < n) break;
+            }
+
+            for (j = n; j > 0 && ext[j-1].lba > x.lba; j--) {
+                ext[j] = ext[j-1];
+            }
+            ext[j] = x;
+        }
+
+        for (i = 0; i < n; i = j) {
+            count = ext[i].count;
+            sg[0].buffer = ext[i].buffer;
+            sg[0].count  = ext[i].count;
+
+            for (j = i + 1; j < n && ext[j].lba == ext[i].lba + count; j++) {
+                sg[j-i].buffer = ext[j].buffer;
+                sg[j-i].count  = ext[j].count;
+                count += ext[j].count;
+            }
+
+            if (unit->atapi == true) {
+                // ATAPI transfers take a single buffer so the merged extents are still sent one by one
+                for (int k = i; k < j; k++) {
+                    if (unit->cache == NULL) {
+                        error = atapi_translate(ext[k].buffer,ext[k].lba,ext[k].count,&actual,unit,direction);
+                    } else if (direction == READ) {
+                        error = cache_read(ext[k].buffer,ext[k].lba,ext[k].count,unit);
+                    } else {
+                        error = cache_write(ext[k].buffer,ext[k].lba,ext[k].count,unit);
+                    }
+                    if (error != 0) return error;
+                }
+            } else {
+                if (direction == READ) {
+                    error = cache_read_sg(sg,ext[i].lba,count,unit);
+                } else {
+                    error = cache_write_sg(sg,ext[i].lba,count,unit);
+                }
+                if (error != 0) return error;
+            }
+
+            done += count << unit->blockShift;
+            ioreq->io_Actual = done;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * process_request
+ *
+ * Carry out a single IO Request and reply to it
+ *
+ * @param itask Pointer to the IDETask struct
+ * @param ioreq Pointer to the IO Request
+*/
+static void process_request(struct IDETask *itask, struct IOStdReq *ioreq) {
+    struct ExecBase *SysBase = itask->dev->SysBase;
+    struct IDEUnit *unit = (struct IDEUnit *)ioreq->io_Unit;
+    struct IOExtTD *iotd = (struct IOExtTD *)ioreq;
+    UWORD blockShift;
+    ULONG lba;
+    ULONG count;
+    BYTE  error = 0;
+    enum xfer_dir direction = WRITE;
+
+    // The disk change task leaves a unit alone while it is in use, its own polls and ejects don't count
+    if (unit != NULL && ioreq->io_Command != TD_CHANGESTATE && ioreq->io_Command != TD_EJECT)
+        unit->active = true;
+
+    switch (ioreq->io_Command) {
+        case TD_EJECT:
+            if (!unit->atapi) {
+                error  = IOERR_NOCMD;
+                break;
+            }
+            ioreq->io_Actual = (unit->mediumPresent) ? 0 : 1;   // io_Actual reflects the previous state
+
+            bool insert = (ioreq->io_Length == 0) ? true : false;
+
+            if (insert == false) atapi_update_presence(unit,false); // Immediately update medium presence on Eject
+
+            // Look for the new medium on every tick
+            unit->pollInterval  = 1;
+            unit->pollCountdown = 1;
+
+            error = atapi_start_stop_unit(unit,insert,1);
+            break;
+
+        case TD_CHANGESTATE:
+            error   = 0;
+            ioreq->io_Actual = 0;
+            if (unit->atapi) {
+                ioreq->io_Actual = (atapi_check_media(unit) != 0);
+                break;
+            }
+#ifdef SD_DRIVER
+            ioreq->io_Actual = (sd_change_state(unit)) ? 0 : 1;
+#else
+            ioreq->io_Actual = (((struct IDEUnit *)ioreq->io_Unit)->mediumPresent) ? 0 : 1;
+#endif
+            break;
+
+        case TD_PROTSTATUS:
+            error  = 0;
+            if (unit->atapi) {
+                if ((error  = atapi_check_wp(unit)) == TDERR_WriteProt) {
+                    error  = 0;
+                    ioreq->io_Actual = 1;
+                    break;
+                }
+            }
+            ioreq->io_Actual = 0; // Not protected
+            break;
+
+        case ETD_READ:
+        case NSCMD_ETD_READ64:
+            direction = READ;
+            goto validate_etd;
+
+        case ETD_WRITE:
+        case ETD_FORMAT:
+        case NSCMD_ETD_WRITE64:
+        case NSCMD_ETD_FORMAT64:
+            direction = WRITE;
+validate_etd:
+            if (iotd->iotd_Count < unit->changeCount) {
+                error  = TDERR_DiskChanged;
+                break;
+            } else {
+                goto transfer;
+            }
+        case CMD_READ:
+        case TD_READ64:
+        case NSCMD_TD_READ64:
+            direction = READ;
+            goto transfer;
+
+        case CMD_WRITE:
+        case TD_WRITE64:
+        case TD_FORMAT:
+        case TD_FORMAT64:
+        case NSCMD_TD_WRITE64:
+        case NSCMD_TD_FORMAT64:
+            direction = WRITE;
+transfer:
+            if (unit->mediumPresent == false) {
+                Trace("Access attempt without media\n");
+                error  = TDERR_DiskChanged;
+                break;
+            }
+
+            blockShift = ((struct IDEUnit *)ioreq->io_Unit)->blockShift;
+            lba = (((long long)ioreq->io_Actual << 32 | ioreq->io_Offset) >> blockShift);
+            count = (ioreq->io_Length >> blockShift);
+
+            if (count == 0) {
+                error = IOERR_BADLENGTH;
+                break;
+            }
+
+            if ((lba + count) > (unit->logicalSectors)) {
+                Trace("Read past end of device\n");
+                error  = IOERR_BADADDRESS;
+                break;
+            }
+
+            if (unit->atapi == true && unit->cache == NULL) {
+                error  = atapi_translate(ioreq->io_Data, lba, count, &ioreq->io_Actual, unit, direction);
+            } else {
+                if (direction == READ) {
+                    error  = cache_read(ioreq->io_Data, lba, count, unit);
+                } else {
+                    error  = cache_write(ioreq->io_Data, lba, count, unit);
+                }
+                ioreq->io_Actual = ioreq->io_Length;
+            }
+            break;
+
+        case CMD_READ_SG:
+            error = process_sg(ioreq,READ);
+            break;
+
+        case CMD_WRITE_SG:
+            error = process_sg(ioreq,WRITE);
+            break;
+
+        case CMD_PREFETCH:
+            // Only a hint, the blocks are read into the cache once no other requests are waiting
+            lba   = (((long long)ioreq->io_Actual << 32 | ioreq->io_Offset) >> unit->blockShift);
+            count = (ioreq->io_Length >> unit->blockShift);
+            ioreq->io_Actual = 0;
+
+            if ((lba + count) > unit->logicalSectors) {
+                error = IOERR_BADADDRESS;
+                break;
+            }
+
+            cache_prefetch(unit,lba,count);
+            error = 0;
+            break;
+
+        /* SCSI Direct */
+        case HD_SCSICMD:
+            error = handle_scsi_command(ioreq);
+            break;
+
+        case CMD_UPDATE:
+            // Write back dirty blocks and have the drive commit its own cache
+            ioreq->io_Actual = 0;
+            if ((error = cache_flush(unit)) == 0)
+                error = ata_flush(unit);
+            break;
+
+        case CMD_CLEAR:
+            // Drop the read cache, dirty blocks are kept as they have not reached the media yet
+            ioreq->io_Actual = 0;
+            cache_invalidate(unit,0,unit->logicalSectors);
+            error = 0;
+            break;
+
+        case CMD_XFER:
+            if (ioreq->io_Length < 3) {
+                ata_set_xfer(unit,ioreq->io_Length);
+                ioreq->io_Actual = unit->xferMethod; // Report the method now in use
+                error = 0;
+            } else {
+                error = IOERR_ABORTED;
+            }
+            break;
+
+        case CMD_PIO:
+            if (ioreq->io_Length <= 4) {
+                error = ata_set_pio(unit,ioreq->io_Length);
+            } else {
+                error = IOERR_BADADDRESS;
+            }
+            break;
+
+        case CMD_MULTIPLE:
+            if (ioreq->io_Length == MULTIPLE_AUTO) {
+                error = ata_tune_multiple(unit);
+            } else if (ioreq->io_Length <= 0xFF) {
+                error = ata_configure_multiple(unit,ioreq->io_Length);
+            } else {
+                error = IOERR_BADLENGTH;
+            }
+            ioreq->io_Actual = (unit->xferMultiple) ? unit->multipleCount : 0; // Report the block size now in use
+            break;
+
+        /* CMD_DIE: Shut down this task and clean up */
+        case CMD_DIE:
+            Info("Task: CMD_DIE: Shutting down IDE Task\n");
+            cleanup(itask);
+            ReplyMsg(&ioreq->io_Message);
+            RemTask(NULL);
+            Wait(0);
+            break;
+        default:
+            // Unknown commands.
+            error = IOERR_NOCMD;
+            ioreq->io_Actual = 0;
+            break;
+    }
+
+#if DEBUG & DBG_CMD
+    traceCommand(ioreq);
+#endif
+    ioreq->io_Error = error;
+    ReplyMsg(&ioreq->io_Message);
+}
+
+/**
+ * A read or write request waiting in a batch
+ *
+*/
+struct QueuedXfer {
+    struct IOStdReq *ioreq;
+    struct IDEUnit *unit;
+    ULONG lba;
+    ULONG count;
+    enum xfer_dir direction;
+};
+
+/**
+ * queue_xfer
+ *
+ * Add a read or write request to the batch if it can be reordered
+ * Other commands, ATAPI units, bad ranges and requests that overlap a write in the batch
+ * (or a write that overlaps anything in it) end the batch and are processed in arrival order
+ *
+ * @param ioreq Pointer to the IO Request
+ * @param batch The batch being built
+ * @param n Number of requests already in the batch
+ * @returns true if the request was added
+*/
+static bool queue_xfer(struct IOStdReq *ioreq, struct QueuedXfer *batch, UWORD n) {
+    struct IDEUnit *unit = (struct IDEUnit *)ioreq->io_Unit;
+    struct QueuedXfer *x = &batch[n];
+
+    switch (ioreq->io_Command) {
+        case CMD_READ:
+        case TD_READ64:
+        case NSCMD_TD_READ64:
+            x->direction = READ;
+            break;
+
+        case CMD_WRITE:
+        case TD_WRITE64:
+        case NSCMD_TD_WRITE64:
+            x->direction = WRITE;
+            break;
+
+        default:
+            return false;
+    }
+
+    if (unit->atapi || !unit->mediumPresent) return false;
+
+    unit->active = true;
+
+    x->ioreq = ioreq;
+    x->unit  = unit;
+    x->lba   = (((long long)ioreq->io_Actual << 32 | ioreq->io_Offset) >> unit->blockShift);
+    x->count = (ioreq->io_Length >> unit->blockShift);
+
+    if (x->count == 0 || (x->lba + x->count) > unit->logicalSectors) return false;
+
+    for (int i = 0; i < n; i++) {
+        if (batch[i].unit == unit &&
+            (batch[i].direction == WRITE || x->direction == WRITE) &&
+            batch[i].lba < x->lba + x->count && x->lba < batch[i].lba + batch[i].count)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * reply_xfer
+ *
+ * Reply to a request from the batch
+ *
+ * @param x The request
+ * @param error Error to return
+*/
+static void reply_xfer(struct QueuedXfer *x, BYTE error) {
+    struct ExecBase *SysBase = x->unit->SysBase;
+
+    x->ioreq->io_Actual = x->ioreq->io_Length;
+    x->ioreq->io_Error  = error;
+#if DEBUG & DBG_CMD
+    traceCommand(x->ioreq);
+#endif
+    ReplyMsg(&x->ioreq->io_Message);
+}
+
+/**
+ * xfer_before
+ *
+ * C-LOOK ordering, requests at or above the head position sort before those below it
+ *
+ * @param itask Pointer to the IDETask struct
+ * @param a First request
+ * @param b Second request
+ * @returns true if a should be carried out before b
+*/
+static inline bool xfer_before(struct IDETask *itask, struct QueuedXfer *a, struct QueuedXfer *b) {
+    bool wrapA = !(a->unit == itask->headUnit && a->lba >= itask->headLba);
+    bool wrapB = !(b->unit == itask->headUnit && b->lba >= itask->headLba);
+
+    if (wrapA != wrapB) return wrapB;
+    if (a->unit != b->unit) return (a->unit < b->unit);
+    return (a->lba < b->lba);
+}
+
+/**
+ * run_batch
+ *
+ * Sort a batch of reads and writes in C-LOOK order and carry them out
+ * Requests that continue the previous one in the same direction are merged into a single transfer
+ *
+ * @param itask Pointer to the IDETask struct
+ * @param batch The requests
+ * @param n Number of requests in the batch
+*/
+static void run_batch(struct IDETask *itask, struct QueuedXfer *batch, UWORD n) {
+    struct SGEntry sg[ELEVATOR_MAX_BATCH];
+    struct QueuedXfer tmp;
+    struct QueuedXfer *x;
+    ULONG count;
+    BYTE error;
+    int i, j;
+
+    for (i = 1; i < n; i++) {
+        tmp = batch[i];
+        for (j = i; j > 0 && xfer_before(itask,&tmp,&batch[j-1]); j--) {
+            batch[j] = batch[j-1];
+        }
+        batch[j] = tmp;
+    }
+
+    for (i = 0; i < n; i = j) {
+        x     = &batch[i];
+        count = x->count;
+        sg[0].buffer = x->ioreq->io_Data;
+        sg[0].count  = x->count;
+
+        for (j = i + 1; j < n &&
+                        batch[j].unit == x->unit &&
+                        batch[j].direction == x->direction &&
+                        batch[j].lba == x->lba + count; j++) {
+            sg[j-i].buffer = batch[j].ioreq->io_Data;
+            sg[j-i].count  = batch[j].count;
+            count += batch[j].count;
+        }
+
+        if (x->direction == READ) {
+            error = cache_read_sg(sg,x->lba,count,x->unit);
+        } else {
+            error = cache_write_sg(sg,x->lba,count,x->unit);
+        }
+
+        if (error != 0 && j - i > 1) {
+            // Retry one by one so that only the failing requests get the error
+            for (int k = i; k < j; k++) {
+                if (batch[k].direction == READ) {
+                    error = cache_read(batch[k].ioreq->io_Data,batch[k].lba,batch[k].count,batch[k].unit);
+                } else {
+                    error = cache_write(batch[k].ioreq->io_Data,batch[k].lba,batch[k].count,batch[k].unit);
+                }
+                reply_xfer(&batch[k],error);
+            }
+        } else {
+            x->unit->stats.requestsMerged += j - i - 1;
+            for (int k = i; k < j; k++) {
+                reply_xfer(&batch[k],error);
+            }
+        }
+
+        itask->headUnit = x->unit;
+        itask->headLba  = x->lba + count;
+    }
+}
+
+
 /**
  * ide_task
  *
@@ -544,15 +1215,15 @@ void __attribute__((noreturn)) ide_task () {
     struct Task *task = FindTask(NULL);
     struct IDETask *itask = (struct IDETask *)task->tc_UserData;
     struct IOStdReq *ioreq;
-    struct IOExtTD *iotd;
-    struct IDEUnit *unit;
-    UWORD blockShift;
-    ULONG lba;
-    ULONG count;
-    BYTE  error = 0;
-    enum xfer_dir direction = WRITE;
+    struct MinList queue;
+    struct QueuedXfer batch[ELEVATOR_MAX_BATCH];
+#ifdef IDLE_TIMER
+    ULONG signals;
+    ULONG idleSignal = 0;
+#endif
 
     itask->task = task;
+    L_NewList((struct List *)&queue);
 
     Trace("IDE Task: CreatePort()\n");
     // Create the MessagePort used to send us requests
@@ -576,6 +1247,26 @@ void __attribute__((noreturn)) ide_task () {
         Wait(0);
     }
 
+#ifdef IDLE_TIMER
+    if ((itask->idlemp = L_CreatePort(NULL,0)) != NULL && (itask->idletr = (struct timerequest *)L_CreateExtIO(itask->idlemp, sizeof(struct timerequest))) != NULL) {
+        if (OpenDevice("timer.device",UNIT_VBLANK,(struct IORequest *)itask->idletr,0)) {
+            cleanup(itask);
+            RemTask(NULL);
+            Wait(0);
+        }
+        idleSignal = (1 << itask->idlemp->mp_SigBit);
+    } else {
+        Info("Failed to create idle timer MP or Request.\n");
+        cleanup(itask);
+        RemTask(NULL);
+        Wait(0);
+    }
+#endif
+
+#ifdef ATA_IRQ
+    ata_irq_init(itask);
+#endif
+
     if (init_units(itask) == 0) {
         cleanup(itask);
         RemTask(NULL);
@@ -588,158 +1279,64 @@ void __attribute__((noreturn)) ide_task () {
     while (1) {
         // Main loop, handle IO Requests as they come in.
         Trace("IDE Task: WaitPort()\n");
+#if defined(WRITE_CACHE)
+        signals = Wait((1 << itask->iomp->mp_SigBit) | idleSignal | IDE_FLUSH_SIGNAL); // Wait for an IORequest, an idle tick or a flush request
+#elif defined(IDLE_TIMER)
+        signals = Wait((1 << itask->iomp->mp_SigBit) | idleSignal); // Wait for an IORequest or an idle tick
+#else
         Wait(1 << itask->iomp->mp_SigBit); // Wait for an IORequest to show up
+#endif
 
+        // Drain the port so that the requests waiting together can be reordered and merged
         while ((ioreq = (struct IOStdReq *)GetMsg(itask->iomp)) != NULL) {
-            unit = (struct IDEUnit *)ioreq->io_Unit;
-            iotd = (struct IOExtTD *)ioreq;
-
-            direction = WRITE;
-
-            switch (ioreq->io_Command) {
-                case TD_EJECT:
-                    if (!unit->atapi) {
-                        error  = IOERR_NOCMD;
-                        break;
-                    }
-                    ioreq->io_Actual = (unit->mediumPresent) ? 0 : 1;   // io_Actual reflects the previous state
-
-                    bool insert = (ioreq->io_Length == 0) ? true : false;
-
-                    if (insert == false) atapi_update_presence(unit,false); // Immediately update medium presence on Eject
-
-                    error = atapi_start_stop_unit(unit,insert,1);
-                    break;
-
-                case TD_CHANGESTATE:
-                    error   = 0;
-                    ioreq->io_Actual = 0;
-                    if (unit->atapi) {
-                        ioreq->io_Actual = (atapi_test_unit_ready(unit) != 0);
-                        break;
-                    }
-                    ioreq->io_Actual = (((struct IDEUnit *)ioreq->io_Unit)->mediumPresent) ? 0 : 1;
-                    break;
-
-                case TD_PROTSTATUS:
-                    error  = 0;
-                    if (unit->atapi) {
-                        if ((error  = atapi_check_wp(unit)) == TDERR_WriteProt) {
-                            error  = 0;
-                            ioreq->io_Actual = 1;
-                            break;
-                        }
-                    }
-                    ioreq->io_Actual = 0; // Not protected
-                    break;
-
-                case ETD_READ:
-                case NSCMD_ETD_READ64:
-                    direction = READ;
-                    goto validate_etd;
-
-                case ETD_WRITE:
-                case ETD_FORMAT:
-                case NSCMD_ETD_WRITE64:
-                case NSCMD_ETD_FORMAT64:
-                    direction = WRITE;
-validate_etd:
-                    if (iotd->iotd_Count < unit->changeCount) {
-                        error  = TDERR_DiskChanged;
-                        break;
-                    } else {
-                        goto transfer;
-                    }
-                case CMD_READ:
-                case TD_READ64:
-                case NSCMD_TD_READ64:
-                    direction = READ;
-                    goto transfer;
-
-                case CMD_WRITE:
-                case TD_WRITE64:
-                case TD_FORMAT:
-                case TD_FORMAT64:
-                case NSCMD_TD_WRITE64:
-                case NSCMD_TD_FORMAT64:
-                    direction = WRITE;
-transfer:
-                    if (unit->atapi == true && unit->mediumPresent == false) {
-                        Trace("Access attempt without media\n");
-                        error  = TDERR_DiskChanged;
-                        break;
-                    }
-
-                    blockShift = ((struct IDEUnit *)ioreq->io_Unit)->blockShift;
-                    lba = (((long long)ioreq->io_Actual << 32 | ioreq->io_Offset) >> blockShift);
-                    count = (ioreq->io_Length >> blockShift);
-
-                    if (count == 0) {
-                        error = IOERR_BADLENGTH;
-                        break;
-                    }
-
-                    if ((lba + count) > (unit->logicalSectors)) {
-                        Trace("Read past end of device\n");
-                        error  = IOERR_BADADDRESS;
-                        break;
-                    }
-
-                    if (unit->atapi == true) {
-                        error  = atapi_translate(ioreq->io_Data, lba, count, &ioreq->io_Actual, unit, direction);
-                    } else {
-                        if (direction == READ) {
-                            error  = ata_read(ioreq->io_Data, lba, count, unit);
-                        } else {
-                            error  = ata_write(ioreq->io_Data, lba, count, unit);
-                        }
-                        ioreq->io_Actual = ioreq->io_Length;
-                    }
-                    break;
+            AddTail((struct List *)&queue,(struct Node *)&ioreq->io_Message.mn_Node);
+        }
 
-                /* SCSI Direct */
-                case HD_SCSICMD:
-                    error = handle_scsi_command(ioreq);
-                    break;
+        while ((ioreq = (struct IOStdReq *)queue.mlh_Head)->io_Message.mn_Node.ln_Succ != NULL) {
+            // Batches are taken in arrival order and never grow past ELEVATOR_MAX_BATCH,
+            // so a request can only be overtaken by others from its own batch
+            UWORD n = 0;
+            struct IOStdReq *next;
+
+            while (n < ELEVATOR_MAX_BATCH &&
+                   (next = (struct IOStdReq *)ioreq->io_Message.mn_Node.ln_Succ) != NULL &&
+                   queue_xfer(ioreq,batch,n)) {
+                Remove(&ioreq->io_Message.mn_Node);
+                ioreq = next;
+                n++;
+            }
 
-                case CMD_XFER:
-                    if (ioreq->io_Length < 3) {
-                        ata_set_xfer(unit,ioreq->io_Length);
-                        error = 0;
-                    } else {
-                        error = IOERR_ABORTED;
-                    }
-                    break;
+            if (n > 0) {
+                run_batch(itask,batch,n);
+            } else {
+                Remove(&ioreq->io_Message.mn_Node);
+                process_request(itask,ioreq);
+            }
+        }
 
-                case CMD_PIO:
-                    if (ioreq->io_Length <= 4) {
-                        error = ata_set_pio(unit,ioreq->io_Length);
-                    } else {
-                        error = IOERR_BADADDRESS;
-                    }
-                    break;
+#ifdef READ_CACHE
+        prefetch_units(itask);
+#endif
 
-                /* CMD_DIE: Shut down this task and clean up */
-                case CMD_DIE:
-                    Info("Task: CMD_DIE: Shutting down IDE Task\n");
-                    cleanup(itask);
-                    ReplyMsg(&ioreq->io_Message);
-                    RemTask(NULL);
-                    Wait(0);
-                    break;
-                default:
-                    // Unknown commands.
-                    error = IOERR_NOCMD;
-                    ioreq->io_Actual = 0;
-                    break;
-            }
+#ifdef WRITE_CACHE
+        if (signals & IDE_FLUSH_SIGNAL) {
+            struct IDEUnit *unit;
 
-#if DEBUG & DBG_CMD
-            traceCommand(ioreq);
+            for (unit = (struct IDEUnit *)itask->dev->units.mlh_Head;
+                 unit->mn_Node.mln_Succ != NULL;
+                 unit = (struct IDEUnit *)unit->mn_Node.mln_Succ) {
+                    if (unit->itask == itask) cache_flush(unit);
+                 }
+        }
 #endif
-            ioreq->io_Error = error;
-            ReplyMsg(&ioreq->io_Message);
+#ifdef IDLE_TIMER
+        bool tick = false;
+        if ((signals & idleSignal) && GetMsg(itask->idlemp) != NULL) {
+            itask->idleArmed = false;
+            tick = true;
         }
+        idle_units(itask,tick);
+#endif
     }
 
 }
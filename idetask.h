@@ -2,16 +2,36 @@
 /* This file is part of lide.device
  * Copyright (C) 2023 Matthew Harlum <matt@harlum.net>
  */
+#include <dos/dos.h>
+
 #define ATA_TASK_NAME    "lide ata task"
 #define CHANGE_TASK_NAME "lide change task"
 #define TASK_PRIORITY 11
 #define TASK_STACK_SIZE 8192
 
-#define CHANGEINT_INTERVAL 2 // Poll units every x seconds for disk change
+#define CHANGEINT_INTERVAL 1 // Disk change task tick in seconds, a unit is polled after 1 tick following a change
+#define CHANGEINT_MAX_TICKS 4 // Poll interval doubles up to this many ticks while the medium doesn't change
+#define IDLE_INTERVAL_US 50000 // Idle tick while a unit has an open SD stream or dirty cached blocks
+
+#if defined(SD_DRIVER) || defined(WRITE_CACHE)
+#define IDLE_TIMER
+#endif
+
+#define ELEVATOR_MAX_BATCH 32 // Most read/write requests sorted and merged together
+#define SG_MAX_EXTENTS     32 // Most CMD_READ_SG/CMD_WRITE_SG descriptors sorted and merged together
+
+#define IDE_FLUSH_SIGNAL SIGBREAKF_CTRL_F // Sent by expunge to have the IDE tasks write back their caches
 
 #define CMD_DIE  0x1000
 #define CMD_XFER (CMD_DIE + 1)
 #define CMD_PIO  (CMD_XFER + 1)
+#define CMD_STATS (CMD_PIO + 1)
+#define CMD_MULTIPLE (CMD_STATS + 1)
+#define CMD_READ_SG  (CMD_MULTIPLE + 1) // io_Data points to io_Length struct SGDescriptor
+#define CMD_WRITE_SG (CMD_READ_SG + 1)
+#define CMD_PREFETCH (CMD_WRITE_SG + 1) // io_Offset/io_Actual/io_Length as TD_READ64 but no data, replied at once
+
+#define MULTIPLE_AUTO 0x100 // CMD_MULTIPLE io_Length to re-run the DRQ block size tuning pass
 
 void ide_task();
 void diskchange_task();
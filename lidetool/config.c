@@ -19,6 +19,7 @@
 #include <stdbool.h>
 #include <proto/exec.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "main.h"
 #include "config.h"
@@ -48,6 +49,7 @@ struct Config* configure(int argc, char *argv[]) {
   config->Device = "lide.device";
   config->DumpInfo = false;
   config->DumpIdent = false;
+  config->DumpStats = false;
 
   for (int i=1; i<argc; i++) {
     if (argv[i][0] == '-') {
@@ -67,7 +69,11 @@ struct Config* configure(int argc, char *argv[]) {
 
         case 'M':
           if (i+1 < argc) {
-            config->Multiple = (*argv[i+1])-'0';
+            if (*argv[i+1] == 'a') {
+              config->Multiple = MULTIPLE_AUTO;
+            } else {
+              config->Multiple = atoi(argv[i+1]);
+            }
             i++;
             cmd_selected = true;
           }
@@ -100,6 +106,11 @@ struct Config* configure(int argc, char *argv[]) {
           cmd_selected = true;
           break;
 
+        case 's':
+          config->DumpStats = true;
+          cmd_selected = true;
+          break;
+
       }
     }
   }
@@ -120,5 +131,5 @@ struct Config* configure(int argc, char *argv[]) {
  * @brief Print the usage information
 */
 void usage() {
-    printf("\nUsage: lidetool -u <unit> -m <method> [-d <device>] [-P <pio mode>] [-p] [-I]\n\n");
+    printf("\nUsage: lidetool -u <unit> -m <method> [-d <device>] [-P <pio mode>] [-M <multiple|a>] [-p] [-I] [-s]\n\n");
 }
@@ -26,6 +26,7 @@ struct Config {
   char *Device;
   bool DumpInfo;
   bool DumpIdent;
+  bool DumpStats;
 };
 
 struct Config* configure(int, char* []);
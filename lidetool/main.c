@@ -170,6 +170,7 @@ static void DumpUnit(struct IOStdReq *req) {
     printf("Logical Sectors:     %ld\n", (long int)unit->logicalSectors);
     printf("READ/WRITE Multiple: %s\n", (unit->xferMultiple) ? "Yes" : "No");
     printf("Multiple count:      %d\n", unit->multipleCount);
+    printf("Write cache:         %s\n", (unit->writeCache) ? "Yes" : "No");
     printf("Last Error: ");
     for (int i=0; i<6; i++) {
       printf("%02x ",unit->last_error[i]);
@@ -178,6 +179,72 @@ static void DumpUnit(struct IOStdReq *req) {
 
 }
 
+/**
+ * hitRate
+ *
+ * @param hits Number of hits
+ * @param misses Number of misses
+ * @returns Hit rate in percent
+ */
+static ULONG hitRate(ULONG hits, ULONG misses) {
+  ULONG reads = hits + misses;
+
+  if (reads > 0xFFFFFF) {
+    return hits / (reads / 100); // Avoid overflowing hits * 100
+  } else if (reads > 0) {
+    return (hits * 100) / reads;
+  }
+
+  return 0;
+}
+
+/**
+ * dumpStats
+ * 
+ * Print the unit statistics
+ * 
+ * @param req An open IOStdReq 
+ */
+static BYTE dumpStats(struct IOStdReq *req) {
+  BYTE error = 0;
+  struct IDEStats stats;
+
+  req->io_Data    = &stats;
+  req->io_Offset  = 0;
+  req->io_Length  = sizeof(struct IDEStats);
+  req->io_Command = CMD_STATS;
+  error = DoIO((struct IORequest *)req);
+  if (error == 0) {
+    printf("Cache hits:          %ld\n", (long int)stats.cacheHits);
+    printf("Cache misses:        %ld\n", (long int)stats.cacheMisses);
+    printf("Cache hit rate:      %ld%%\n", (long int)hitRate(stats.cacheHits,stats.cacheMisses));
+    printf("Hot block hits:      %ld\n", (long int)stats.hotHits);
+    printf("Hot block misses:    %ld\n", (long int)stats.hotMisses);
+    printf("Hot block hit rate:  %ld%%\n", (long int)hitRate(stats.hotHits,stats.hotMisses));
+    printf("Requests merged:     %ld\n", (long int)stats.requestsMerged);
+
+    for (int i=0; i<XFER_TICKS_SLOTS; i++) {
+      if (stats.xferTicks[i] > 0) {
+        if (i == XFER_TICKS_UNALIGNED) {
+          printf("Unaligned xfer ticks: %ld\n", (long int)stats.xferTicks[i]);
+        } else {
+          printf("Xfer method %d ticks: %ld\n", i, (long int)stats.xferTicks[i]);
+        }
+      }
+    }
+
+    for (int i=0; i<MULTIPLE_STEPS; i++) {
+      if (stats.multipleTicks[i] > 0) {
+        printf("Multiple %3d ticks:  %ld\n", 1 << i, (long int)stats.multipleTicks[i]);
+      }
+    }
+  } else {
+    printf("IO Error %d\n", error);
+  }
+
+  return error;
+}
+
 /**
  * setTransferMode
  * 
@@ -194,7 +261,7 @@ BYTE setTransferMode(struct IOStdReq *req) {
   req->io_Command = CMD_XFER;
   error = DoIO((struct IORequest *)req);
   if (error == 0) {
-    printf("Transfer mode configured for unit %d\n",config->Unit);
+    printf("Transfer mode %ld configured for unit %d\n",(long int)req->io_Actual,config->Unit);
   } else {
     printf("IO Error %d\n", error);
   }
@@ -290,23 +357,31 @@ BYTE identify(struct IOStdReq *req) {
 /**
  * setMultiple
  * 
+ * Set the DRQ block size on the unit, or re-run the tuning pass with MULTIPLE_AUTO
+ * 
  * @param req An open IOStdReq
  * @param multiple Multiple count
  * 
 */
-static void setMultiple(struct IOStdReq *req, int multiple) {
-  struct IDEUnit *unit = (struct IDEUnit *)req->io_Unit;
+static BYTE setMultiple(struct IOStdReq *req, int multiple) {
+  BYTE error = 0;
 
-  if (multiple > 0) {
-    unit->xferMultiple = true;
-    unit->multipleCount = multiple;
-    printf("set multiple transfer: %d\n",multiple);
+  req->io_Data    = NULL;
+  req->io_Offset  = 0;
+  req->io_Length  = multiple;
+  req->io_Command = CMD_MULTIPLE;
+  error = DoIO((struct IORequest *)req);
+  if (error == 0) {
+    if (req->io_Actual > 0) {
+      printf("Multiple count %ld configured for unit %d\n",(long int)req->io_Actual,config->Unit);
+    } else {
+      printf("Transfer multiple disabled.\n");
+    }
   } else {
-    printf("Transfer multiple disabled.\n");
-    unit->xferMultiple = false;
-    unit->multipleCount = 1;
+    printf("IO Error %d\n", error);
   }
 
+  return error;
 }
 int main(int argc, char *argv[])
 {
@@ -352,6 +427,10 @@ int main(int argc, char *argv[])
             identify(req);
           }
 
+          if (config->DumpStats) {
+            dumpStats(req);
+          }
+
           CloseDevice((struct IORequest *)req);
         } else {
           printf("Error %d opening %s", error, config->Device);
@@ -53,6 +53,10 @@ struct __attribute__((packed)) SCSI_CDB_10 {
 
 #define CMD_XFER 0x1001
 #define CMD_PIO  (CMD_XFER + 1)
+#define CMD_STATS (CMD_PIO + 1)
+#define CMD_MULTIPLE (CMD_STATS + 1)
+
+#define MULTIPLE_AUTO 0x100
 
 
 #endif
@@ -49,6 +49,8 @@
 #define READY_TIMEOUT_MS        500
 #define INIT_TIMEOUT_MS         1000
 #define MAX_RESPONSE_POLLS      10
+#define POLL_CHUNK              32      /* bytes polled per spi_poll() call */
+#define POLL_CHECK_EVERY        8       /* spi_poll() calls between clock reads */
 
 /* MMC/SD command */
 #define CMD0    (0)             /* GO_IDLE_STATE */
@@ -58,6 +60,7 @@
 #define CMD9    (9)             /* SEND_CSD */
 #define CMD10   (10)            /* SEND_CID */
 #define CMD12   (12)            /* STOP_TRANSMISSION */
+#define CMD13   (13)            /* SEND_STATUS */
 #define ACMD13  (0x80+13)       /* SD_STATUS (SDC) */
 #define CMD16   (16)            /* SET_BLOCKLEN */
 #define CMD17   (17)            /* READ_SINGLE_BLOCK */
@@ -193,48 +196,61 @@ static int sd_wait_ready(spi_t *spi)
 	TIMER timeout;
 	uint8_t in;
 
-	timeout = timer_set( TIMER_MILLIS(READY_TIMEOUT_MS) );
+	timer_start(&spi->timebase, &timeout, TIMER_MILLIS(READY_TIMEOUT_MS), POLL_CHECK_EVERY);
 	do
 	{
-		spi_read(spi, &in, 1);
+		in = SPI_POLL_BYTE(spi_poll(spi, 0xff, 0xff, TRUE, POLL_CHUNK));
 	}
-	while ( (in != 0xff) && !timer_check(timeout) );
+	while ( (in != 0xff) && !timer_poll(&spi->timebase, &timeout) );
 
 	return (in == 0xff) ? 0 : sdError_Timeout;
 }
 
-static void sd_deselect(spi_t *spi)
+/*! Wait for the card to finish a pending busy phase, if any */
+static int sd_wait_not_busy(sd_card_info_t *ci)
 {
-    //de-assert /CS
-    spi_deselect();
-
-    //8 more clock cycles after de-asserting /CS to tristate MISO
-    uint8_t cmd = 0xff;
-    spi_write(spi, &cmd, 1);
-
-    //release the bus now for other users
-    spi_release(spi);
+    if (ci->busy) {
+        if (sd_wait_ready(&ci->spi) < 0) {
+            Warn("Timeout waiting for card ready\n");
+            return sdError_Timeout;
+        }
+        ci->busy = 0;
+    }
+    return 0;
 }
 
-static int sd_select(spi_t *spi)
+/*! Start a session: obtain the bus and assert /CS until sd_session_end() */
+static void sd_session_begin(sd_card_info_t *ci)
 {
+    if (ci->selected)
+        return;
+
     //obtain the bus before doing anything
-    spi_obtain(spi);
+    spi_obtain(&ci->spi);
 
     //assert /CS
-    spi_select(spi);
+    spi_select(&ci->spi);
+    ci->selected = 1;
+}
 
-	//wait for card ready
-    if (sd_wait_ready(spi) == 0)
-    {
-   		return 0;
-    }
+/*! End a session: de-assert /CS and release the bus */
+static void sd_session_end(sd_card_info_t *ci)
+{
+    spi_t *spi = &ci->spi;
+
+    if (!ci->selected)
+        return;
 
-    //timeout, de-assert /CS
+    //de-assert /CS
     spi_deselect();
 
-    Warn("Timeout waiting for card ready\n");
-    return sdError_Timeout;
+    //8 more clock cycles after de-asserting /CS to tristate MISO
+    uint8_t cmd = 0xff;
+    spi_write(spi, &cmd, 1);
+
+    //release the bus now for other users
+    spi_release(spi);
+    ci->selected = 0;
 }
 
 static int sd_read_block(spi_t *spi, uint8_t *buf, unsigned int size)
@@ -243,10 +259,10 @@ static int sd_read_block(spi_t *spi, uint8_t *buf, unsigned int size)
     uint8_t token, crc[2];
 
     /* Wait for data start token */
-	timeout = timer_set( TIMER_MILLIS(READY_TIMEOUT_MS) );
+	timer_start(&spi->timebase, &timeout, TIMER_MILLIS(READY_TIMEOUT_MS), POLL_CHECK_EVERY);
 	do {
-        spi_read(spi, &token, 1);
-    } while (token == 0xff && !timer_check(timeout));
+        token = SPI_POLL_BYTE(spi_poll(spi, 0xff, 0xff, FALSE, POLL_CHUNK));
+    } while (token == 0xff && !timer_poll(&spi->timebase, &timeout));
     if (token != 0xfe) {
         Warn("No data token received\n");
         return sdError_Timeout;
@@ -259,13 +275,13 @@ static int sd_read_block(spi_t *spi, uint8_t *buf, unsigned int size)
     return 0;
 }
 
-static int sd_write_block(spi_t *spi, const uint8_t *buf, uint8_t token)
+static int sd_write_block(sd_card_info_t *ci, const uint8_t *buf, uint8_t token)
 {
+    spi_t *spi = &ci->spi;
     uint8_t crc[2] = {0xff, 0xff};
     uint8_t resp;
 
-    if (sd_wait_ready(spi) < 0) {
-        Warn("Card not ready\n");
+    if (sd_wait_not_busy(ci) < 0) {
         return sdError_Timeout;
     }
 
@@ -282,32 +298,40 @@ static int sd_write_block(spi_t *spi, const uint8_t *buf, uint8_t token)
             Warn("Bad response\n");
             return sdError_BadResponse;
         }
+    } else {
+        /* Skip the byte before the card signals busy */
+        spi_read(spi, &resp, 1);
     }
 
+    /* Card is programming now, the next command waits for it */
+    ci->busy = 1;
     return 0;
 }
 
-static uint8_t sd_send_cmd(spi_t *spi, uint8_t cmd, uint32_t arg)
+static uint8_t sd_send_cmd(sd_card_info_t *ci, uint8_t cmd, uint32_t arg)
 {
+    spi_t *spi = &ci->spi;
     uint8_t res;
     uint8_t buf[6];
-    int n;
 
     if (cmd & 0x80) {
         /* Send CMD55 prior to ACMD */
         cmd &= 0x7f;
-        res = sd_send_cmd(spi, CMD55, 0);
+        res = sd_send_cmd(ci, CMD55, 0);
         if (res > 1) {
             return res;
         }
     }
 
-    /* Select the card and wait for ready except for abort */
+    /* Keep the card selected for the whole session. Only wait for ready
+     * when the card may still be busy, otherwise one filler byte is enough.
+     * An abort is sent right away. */
+    sd_session_begin(ci);
     if (cmd != CMD12) {
-        sd_deselect(spi);
-        if (sd_select(spi) < 0) {
+        if (sd_wait_not_busy(ci) < 0) {
             return 0xff;
         }
+        spi_read(spi, &res, 1);
     }
 
     /* Build command */
@@ -331,16 +355,58 @@ static uint8_t sd_send_cmd(spi_t *spi, uint8_t cmd, uint32_t arg)
         spi_read(spi, &res, 1);
     }
 
-    for (n = 0; n < MAX_RESPONSE_POLLS; n++) {
-        spi_read(spi, &res, 1);
-        if (!(res & 0x80)) {
-            break;
-        }
+    res = SPI_POLL_BYTE(spi_poll(spi, 0x80, 0x00, TRUE, MAX_RESPONSE_POLLS));
+
+    /* R1b: the card signals busy after stopping a transfer */
+    if (cmd == CMD12) {
+        ci->busy = 1;
     }
 
     return res;
 }
 
+/*! Command argument for an LBA, standard capacity cards use byte addressing */
+static uint32_t sd_address(sd_card_info_t *ci, ULONG lba)
+{
+    return (ci->type == sdCardType_SDHC) ? lba : lba << SD_SECTOR_SHIFT;
+}
+
+/*! First LBA past the AU that contains lba */
+static ULONG sd_au_end(sd_card_info_t *ci, ULONG lba)
+{
+    if (ci->au_sectors == 0)
+        return 0xFFFFFFFFUL;
+
+    return lba - (lba % ci->au_sectors) + ci->au_sectors;
+}
+
+/*! Read the AU size from SD_STATUS, fall back to the CSD erase sector size */
+static void sd_read_au_size(sd_card_info_t *ci)
+{
+    static const uint32_t au_sectors[15] = {
+        32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 24576, 32768, 49152, 65536, 131072
+    };
+    uint8_t status[64];
+    uint8_t code = 0;
+
+    if (sd_send_cmd(ci, ACMD13, 0) == 0) {
+        /* Skip the second byte of the R2 response */
+        spi_read(&ci->spi, status, 1);
+        if (sd_read_block(&ci->spi, status, sizeof(status)) == 0) {
+            code = status[10] >> 4;
+        }
+    }
+
+    if (code) {
+        ci->au_sectors = au_sectors[code - 1];
+    } else {
+        /* Erase sector size is in units of the write block length */
+        ci->au_sectors = (uint32_t)(ci->csd.erase_sector_size + 1) << (ci->csd.write_block_len - SD_SECTOR_SHIFT);
+    }
+
+    Info("AU size = %lu sectors\n",(unsigned long)ci->au_sectors);
+}
+
 static uint32_t sd_get_r7_resp(spi_t *spi)
 {
     uint8_t buf[4];
@@ -414,13 +480,93 @@ uint8_t sd_hex_nibble_to_char(uint8_t c)
 //ATA emulation functions
 
 /**
- * ata_init_unit
+ * sd_bench
+ *
+ * Measure the amount of E Clock ticks taken to clock 64K in and out of the bus with the current kernels
+ * The card is not selected so it ignores the traffic
  *
- * Initialize an SD card, check if it is there and responding
  * @param unit Pointer to an IDEUnit struct
- * @returns false on error
+ * @param buffer Pointer to a 512 byte buffer
+ * @return tick count, 0 if ReadEClock is not available
+ */
+static ULONG sd_bench(struct IDEUnit *unit, uint8_t *buffer)
+{
+    struct Device *TimerBase = unit->itask->tr->tr_node.io_Device;
+    spi_t *spi = &unit->sd_card_info.spi;
+    struct EClockVal startTime;
+    struct EClockVal endTime;
+
+    if (TimerBase->dd_Library.lib_Version < 36) return 0;
+
+    memset(buffer, 0xff, SD_SECTOR_SIZE);
+
+    spi_obtain(spi);
+    spi_deselect();
+
+    ReadEClock(&startTime);
+
+    for (int i=0; i<64; i++) {
+        spi_read(spi, buffer, SD_SECTOR_SIZE);
+        spi_write(spi, buffer, SD_SECTOR_SIZE);
+    }
+
+    ReadEClock(&endTime);
+
+    spi_release(spi);
+
+    return (*(uint64_t *)&endTime) - (*(uint64_t *)&startTime);
+}
+
+/**
+ * sd_autoselect_xfer
+ *
+ * Pick the SPI transfer kernels for the CPU, benchmarking them where ReadEClock is available
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @return transfer method
+ */
+static enum xfer sd_autoselect_xfer(struct IDEUnit *unit)
+{
+    struct ExecBase *SysBase = unit->SysBase;
+    enum xfer method = spi_xfer_68000;
+    uint8_t *buf;
+
+    // The 68000 kernels are always fastest on a 68000/010
+    if ((SysBase->AttnFlags & (AFF_68020 | AFF_68030 | AFF_68040 | AFF_68060)) == 0)
+        return spi_xfer_68000;
+
+    // ReadEClock needed by sd_bench not supported before Kick 2.0
+    if (SysBase->LibNode.lib_Version < 36)
+        return spi_xfer_68020;
+
+    if ((buf = AllocMem(SD_SECTOR_SIZE+1,MEMF_ANY))) {
+        ULONG *ticks = unit->stats.xferTicks;
+
+        ata_set_xfer(unit, spi_xfer_68000);
+        ticks[spi_xfer_68000] = sd_bench(unit, buf);
+        ata_set_xfer(unit, spi_xfer_68020);
+        ticks[spi_xfer_68020] = sd_bench(unit, buf);
+        if (ticks[spi_xfer_68000] == 0 || ticks[spi_xfer_68020] < ticks[spi_xfer_68000]) {
+            method = spi_xfer_68020;
+        }
+        // Not selectable, timed so that the odd buffer path can be compared with the others
+        ticks[XFER_TICKS_UNALIGNED] = sd_bench(unit, buf + 1);
+        FreeMem(buf,SD_SECTOR_SIZE+1);
+    }
+
+    Info("SD: transfer method %ld\n",(ULONG)method);
+    return method;
+}
+
+/**
+ * sd_init_card
+ *
+ * Reset the card in the slot and bring it up: card type, CID, CSD and AU size
+ * The SPI interface must have been set up by ata_init_unit()
+ * @param unit Pointer to an IDEUnit struct
+ * @returns false if there is no working card
 */
-bool ata_init_unit(struct IDEUnit *unit)
+static bool sd_init_card(struct IDEUnit *unit)
 {
     sd_card_info_t *ci = &unit->sd_card_info;
     spi_t *spi = &unit->sd_card_info.spi;
@@ -429,32 +575,16 @@ bool ata_init_unit(struct IDEUnit *unit)
     uint32_t resp[4];
     int err;
 
-    //initial values
-    unit->cylinders         = 0;
-    unit->heads             = 0;
-    unit->sectorsPerTrack   = 0;
-    unit->blockSize         = 0;
-    unit->present           = false;
-    unit->mediumPresent     = false;
-    unit->atapi             = false;
-    unit->deviceType        = 0;
-
-    if(unit->unitNum > 0)
-    {
-        //unit number not supported
-        Warn("unit not supported\n");
-        return false;
-    }
-
-    //initialize SPI interface
-    if(spi_initialize(spi, SPI_CHANNEL_1, unit->SysBase) != 1)
-        return false;
-
     spi_set_speed(spi, SPI_SPEED_SLOW);
 
     ci->type = sdCardType_None;
     ci->total_sectors = 0;
     ci->block_size = sdBlockSize_512;
+    ci->selected = 0;
+    ci->busy = 1;
+    ci->au_sectors = 0;
+    unit->streamState = sdStream_None;
+    unit->streamLba = 0;
 
     //reset sequence
     spi_obtain(spi);
@@ -462,11 +592,11 @@ bool ata_init_unit(struct IDEUnit *unit)
     cmd = 0xFF;
     for(int i=0; i<10; i++)
         spi_write(spi,&cmd,1);
-    timer_wait(TIMER_MILLIS(RESET_DELAY_MS));
+    timer_delay(&spi->timebase, TIMER_MILLIS(RESET_DELAY_MS));
 
     //start init sequence
-    if (sd_send_cmd(spi, CMD0,0) == 1) {
-        if (sd_send_cmd(spi, CMD8, 0x1aa) == 1) {
+    if (sd_send_cmd(ci, CMD0,0) == 1) {
+        if (sd_send_cmd(ci, CMD8, 0x1aa) == 1) {
             uint32_t ocr = sd_get_r7_resp(spi);
 
             if (ocr == 0x000001aa) {
@@ -474,18 +604,19 @@ bool ata_init_unit(struct IDEUnit *unit)
                 ci->type = sdCardType_SD2_0;
 
                 /* Wait for card ready */
-                timeout = timer_set(TIMER_MILLIS(INIT_TIMEOUT_MS));
-                while (sd_send_cmd(spi, ACMD41, (1ul << 30)) > 0) {
-                    if (timer_check(timeout)) {
+                timer_start(&spi->timebase, &timeout, TIMER_MILLIS(INIT_TIMEOUT_MS), 1);
+                while (sd_send_cmd(ci, ACMD41, (1ul << 30)) > 0) {
+                    if (timer_check(&spi->timebase, &timeout)) {
                         /* Init timed out - invalidate card */
                         Warn("Init timed out\n");
                         ci->type = sdCardType_None;
+                        break;
                     }
                 }
 
                 if (ci->type) {
                     /* Read OCR */
-                    if (sd_send_cmd(spi, CMD58, 0) == 0) {
+                    if (sd_send_cmd(ci, CMD58, 0) == 0) {
                         ocr = sd_get_r7_resp(spi);
                         if (ocr & (1ul << 30)) {
                             /* Card is high capacity */
@@ -500,7 +631,7 @@ bool ata_init_unit(struct IDEUnit *unit)
             }
         } else {
             /* Not SDv2 */
-            if (sd_send_cmd(spi, ACMD41, 0) <= 1) {
+            if (sd_send_cmd(ci, ACMD41, 0) <= 1) {
                 Trace("SDv1\n");
                 ci->type = sdCardType_SD1_x;
                 cmd = ACMD41;
@@ -511,18 +642,19 @@ bool ata_init_unit(struct IDEUnit *unit)
             }
 
             /* Wait for card ready */
-            timeout = timer_set(TIMER_MILLIS(INIT_TIMEOUT_MS));
-            while (sd_send_cmd(spi, cmd, 0) > 0) {
-                if (timer_check(timeout)) {
+            timer_start(&spi->timebase, &timeout, TIMER_MILLIS(INIT_TIMEOUT_MS), 1);
+            while (sd_send_cmd(ci, cmd, 0) > 0) {
+                if (timer_check(&spi->timebase, &timeout)) {
                     /* Init timed out - invalidate card */
                     Warn("Init timed out\n");
                     ci->type = sdCardType_None;
+                    break;
                 }
             }
 
             if (ci->type) {
                 /* Set block length */
-                if (sd_send_cmd(spi, CMD16, SD_SECTOR_SIZE) > 0) {
+                if (sd_send_cmd(ci, CMD16, SD_SECTOR_SIZE) > 0) {
                     Warn("Failed to set block length\n");
                     ci->type = sdCardType_None;
                 }
@@ -534,7 +666,7 @@ bool ata_init_unit(struct IDEUnit *unit)
         Info("SD card ready (type %lu)\n", (unsigned long)ci->type);
 
         /* Read and decode card info */
-        if (sd_send_cmd(spi, CMD10, 0) == 0) {
+        if (sd_send_cmd(ci, CMD10, 0) == 0) {
             err = sd_read_block(spi, (uint8_t*)&resp, sizeof(resp));
             if (err < 0) {
                 Warn("Read CID failed\n");
@@ -546,7 +678,7 @@ bool ata_init_unit(struct IDEUnit *unit)
             err = sd_parse_cid(ci, resp);
         }
         if (err == 0) {
-            if (sd_send_cmd(spi, CMD9, 0) == 0) {
+            if (sd_send_cmd(ci, CMD9, 0) == 0) {
                 err = sd_read_block(spi, (uint8_t*)&resp, sizeof(resp));
                 if (err < 0) {
                     Warn("Read CSD failed\n");
@@ -561,16 +693,59 @@ bool ata_init_unit(struct IDEUnit *unit)
 
         /* Switch to fast clock */
         spi_set_speed(spi, SPI_SPEED_FAST);
+
+        if (err == 0) {
+            sd_read_au_size(ci);
+        }
     } else {
         /* Card not present */
         err = sdError_NoCard;
     }
 
-    sd_deselect(spi);
+    sd_session_end(ci);
 
-    //return false if error occurred
-    if(err != sdError_OK)
+    return (err == sdError_OK);
+}
+
+/**
+ * ata_init_unit
+ *
+ * Initialize an SD card, check if it is there and responding
+ * @param unit Pointer to an IDEUnit struct
+ * @returns false on error
+*/
+bool ata_init_unit(struct IDEUnit *unit)
+{
+    spi_t *spi = &unit->sd_card_info.spi;
+
+    //initial values
+    unit->cylinders         = 0;
+    unit->heads             = 0;
+    unit->sectorsPerTrack   = 0;
+    unit->blockSize         = 0;
+    unit->present           = false;
+    unit->mediumPresent     = false;
+    unit->atapi             = false;
+    unit->deviceType        = 0;
+
+    if(unit->unitNum > 1)
+    {
+        //unit number not supported
+        Warn("unit not supported\n");
         return false;
+    }
+
+    //initialize SPI interface, unit 0 is the card on channel 1 and unit 1 the card on channel 2
+    if(spi_initialize(spi, (unit->unitNum == 0) ? SPI_CHANNEL_1 : SPI_CHANNEL_2, unit->SysBase) != 1)
+        return false;
+
+    //E clock timeouts where timer.device supports ReadEClock
+    timer_init(&spi->timebase, unit->itask->tr->tr_node.io_Device);
+
+    if (!sd_init_card(unit))
+        return false;
+
+    ata_set_xfer(unit, sd_autoselect_xfer(unit));
 
     // device present
     unit->present = true;
@@ -631,6 +806,16 @@ bool ata_identify(struct IDEUnit *unit, UWORD *buffer)
     return true;
 }
 
+/*! Both cards share the bus and /CS lines, close the other card's open stream before talking to this one.
+    A card that was busy programming keeps going while deselected so the other card is serviced meanwhile */
+static void sd_claim_bus(struct IDEUnit *unit)
+{
+    struct IDEUnit *owner = unit->itask->streamUnit;
+
+    if (owner != NULL && owner != unit)
+        sd_stream_close(owner);
+}
+
 /**
  * ata_read
  *
@@ -642,48 +827,88 @@ bool ata_identify(struct IDEUnit *unit, UWORD *buffer)
  * @returns error
 */
 BYTE ata_read(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit)
+{
+    struct SGEntry sg = {buffer, count};
+
+    return ata_read_sg(&sg, lba, count, unit);
+}
+
+/**
+ * ata_read_sg
+ *
+ * Read contiguous blocks from the SD card into a list of buffers
+ * @param sg Buffers to fill in order, their counts must add up to count
+ * @param lba LBA Address
+ * @param count Number of blocks to transfer
+ * @param unit Pointer to the unit structure
+ * @returns error
+*/
+BYTE ata_read_sg(struct SGEntry *sg, ULONG lba, ULONG count, struct IDEUnit *unit)
 {
     sd_card_info_t *ci = &unit->sd_card_info;
     spi_t *spi = &unit->sd_card_info.spi;
+    uint8_t *buffer = sg->buffer;
+    ULONG sg_count = sg->count;
     int err = 0;
 
     if (ci->type == sdCardType_None) {
         Warn("No card\n");
         return IOERR_OPENFAIL;
     }
-    if (ci->type != sdCardType_SDHC) {
-        /* Convert lba to byte addressing (x512) */
-        lba <<= 9;
-    }
 
-    if (count == 1) {
-        /* Read single sector */
-        if (sd_send_cmd(spi, CMD17, lba) == 0) {
-            err = sd_read_block(spi, buffer, SD_SECTOR_SIZE);
-        } else {
-            err = sdError_BadResponse;
+    sd_claim_bus(unit);
+
+    /* Close an open stream this request does not continue */
+    if (unit->streamState != sdStream_None) {
+        if (unit->streamState != sdStream_Read || lba != unit->streamLba || spi_contended(spi)) {
+            sd_stream_close(unit);
         }
-    } else {
-        /* Read multiple sectors */
-        if (sd_send_cmd(spi, CMD18, lba) == 0) {
-            do {
-                err = sd_read_block(spi, buffer, SD_SECTOR_SIZE);
-                if (err < 0) {
-                    break;
-                }
-                buffer += SD_SECTOR_SIZE;
-            } while (--count);
+    }
 
-            /* Send CMD12 stop transmission */
-            if (err == 0) {
-                err = sd_send_cmd(spi, CMD12, 0);
+    if (unit->streamState == sdStream_None) {
+        if (count == 1 && lba != unit->streamLba) {
+            /* Read single sector */
+            if (sd_send_cmd(ci, CMD17, sd_address(ci, lba)) == 0) {
+                err = sd_read_block(spi, buffer, SD_SECTOR_SIZE);
+            } else {
+                err = sdError_BadResponse;
             }
-        } else {
-            err = sdError_BadResponse;
+            unit->streamLba = lba + 1;
+            sd_session_end(ci);
+            return (err != sdError_OK) ? IOERR_ABORTED : 0;
+        }
+
+        /* Sequential or multiple sectors: open a read stream */
+        if (sd_send_cmd(ci, CMD18, sd_address(ci, lba)) != 0) {
+            sd_session_end(ci);
+            return IOERR_ABORTED;
         }
+        unit->streamState = sdStream_Read;
+        unit->itask->streamUnit = unit;
     }
 
-    sd_deselect(spi);
+    /* Read from the stream, it stays open for the next request */
+    do {
+        if (sg_count == 0) {
+            sg++;
+            buffer = sg->buffer;
+            sg_count = sg->count;
+        }
+        sg_count--;
+        err = sd_read_block(spi, buffer, SD_SECTOR_SIZE);
+        if (err < 0) {
+            break;
+        }
+        buffer += SD_SECTOR_SIZE;
+        lba++;
+    } while (--count);
+
+    unit->streamLba    = lba;
+    unit->streamActive = true;
+
+    if (err != sdError_OK || lba >= unit->logicalSectors) {
+        sd_stream_close(unit);
+    }
 
     //return IOERR_ABORTED if error occurred
     if(err != sdError_OK)
@@ -703,71 +928,248 @@ BYTE ata_read(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit)
  * @returns error
 */
 BYTE ata_write(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit)
+{
+    struct SGEntry sg = {buffer, count};
+
+    return ata_write_sg(&sg, lba, count, unit);
+}
+
+/**
+ * ata_write_sg
+ *
+ * Write contiguous blocks to the SD card from a list of buffers
+ * @param sg Buffers to write in order, their counts must add up to count
+ * @param lba LBA Address
+ * @param count Number of blocks to transfer
+ * @param unit Pointer to the unit structure
+ * @returns error
+*/
+BYTE ata_write_sg(struct SGEntry *sg, ULONG lba, ULONG count, struct IDEUnit *unit)
 {
     sd_card_info_t *ci = &unit->sd_card_info;
-    spi_t *spi = &unit->sd_card_info.spi;
+    uint8_t *buffer = sg->buffer;
+    ULONG sg_count = sg->count;
     int err = 0;
 
     if (ci->type == sdCardType_None) {
         Warn("No card\n");
         return IOERR_OPENFAIL;
     }
-    if (ci->type != sdCardType_SDHC) {
-        /* Convert lba to byte addressing (x512) */
-        lba <<= 9;
+
+    sd_claim_bus(unit);
+
+    /* Close an open stream this request does not continue */
+    if (unit->streamState != sdStream_None) {
+        if (unit->streamState != sdStream_Write || lba != unit->streamLba || spi_contended(&ci->spi)) {
+            sd_stream_close(unit);
+        }
     }
 
-    if (count == 1) {
+    if (unit->streamState == sdStream_None && count == 1 && lba != unit->streamLba) {
         /* Write single sector */
-        if (sd_send_cmd(spi, CMD24, lba) == 0) {
-            err = sd_write_block(spi, buffer, 0xfe);
+        if (sd_send_cmd(ci, CMD24, sd_address(ci, lba)) == 0) {
+            err = sd_write_block(ci, buffer, 0xfe);
         } else {
             err = sdError_BadResponse;
         }
-    } else {
-        if (ci->type == sdCardType_SD1_x || ci->type == sdCardType_SD2_0 || ci->type == sdCardType_SDHC) {
-            /* Pre-defined sector count */
-            sd_send_cmd(spi, ACMD23, count);
-        }
-        /* Write multiple sectors */
-        if (sd_send_cmd(spi, CMD25, lba) == 0) {
-            do {
-                err = sd_write_block(spi, buffer, 0xfc);
-                if (err < 0) {
-                    break;
-                }
-                buffer += SD_SECTOR_SIZE;
-            } while (--count);
+        unit->streamLba = lba + 1;
+        sd_session_end(ci);
+        return (err != sdError_OK) ? IOERR_ABORTED : 0;
+    }
 
-            /* Send STOP_TRAN */
-            if (err == 0) {
-                err = sd_write_block(spi, 0, 0xfd);
+    do {
+        if (unit->streamState == sdStream_None) {
+            /* Open a write stream that ends at the next AU boundary */
+            unit->streamEnd = sd_au_end(ci, lba);
+            if (ci->type == sdCardType_SD1_x || ci->type == sdCardType_SD2_0 || ci->type == sdCardType_SDHC) {
+                /* Pre-erase the blocks of this request that fall within the AU */
+                ULONG erase = unit->streamEnd - lba;
+                sd_send_cmd(ci, ACMD23, (erase < count) ? erase : count);
             }
-        } else {
-            err = sdError_BadResponse;
+            if (sd_send_cmd(ci, CMD25, sd_address(ci, lba)) != 0) {
+                err = sdError_BadResponse;
+                break;
+            }
+            unit->streamState = sdStream_Write;
+            unit->itask->streamUnit = unit;
         }
-    }
 
-    sd_deselect(spi);
+        if (sg_count == 0) {
+            sg++;
+            buffer = sg->buffer;
+            sg_count = sg->count;
+        }
+        sg_count--;
+        err = sd_write_block(ci, buffer, 0xfc);
+        if (err < 0) {
+            break;
+        }
+        buffer += SD_SECTOR_SIZE;
+        lba++;
 
-    //return IOERR_ABORTED if error occurred
-    if(err != sdError_OK)
+        if (lba == unit->streamEnd) {
+            /* AU boundary, the next block starts a new stream */
+            sd_stream_close(unit);
+        }
+    } while (--count);
+
+    unit->streamLba    = lba;
+    unit->streamActive = true;
+
+    if (err != sdError_OK) {
+        sd_stream_close(unit);
         return IOERR_ABORTED;
-    else
+    }
+
+    return 0;
+}
+
+/**
+ * sd_stream_close
+ *
+ * Stop an open multi-block transfer and release the SPI bus
+ * @param unit Pointer to the unit structure
+*/
+void sd_stream_close(struct IDEUnit *unit)
+{
+    sd_card_info_t *ci = &unit->sd_card_info;
+
+    if (unit->streamState == sdStream_Read) {
+        /* Send CMD12 stop transmission */
+        sd_send_cmd(ci, CMD12, 0);
+    } else if (unit->streamState == sdStream_Write) {
+        /* Send STOP_TRAN */
+        sd_write_block(ci, 0, 0xfd);
+    }
+
+    unit->streamState  = sdStream_None;
+    unit->streamActive = false;
+    if (unit->itask->streamUnit == unit)
+        unit->itask->streamUnit = NULL;
+    sd_session_end(ci);
+}
+
+/**
+ * ata_flush
+ *
+ * Close any open stream and wait until the card has finished programming
+ * @param unit Pointer to the unit structure
+ * @returns error
+*/
+BYTE ata_flush(struct IDEUnit *unit)
+{
+    sd_card_info_t *ci = &unit->sd_card_info;
+    int err;
+
+    sd_stream_close(unit);
+
+    if (!ci->busy)
         return 0;
+
+    sd_claim_bus(unit);
+    sd_session_begin(ci);
+    err = sd_wait_not_busy(ci);
+    sd_session_end(ci);
+
+    return (err != sdError_OK) ? IOERR_ABORTED : 0;
+}
+
+/**
+ * sd_idle
+ *
+ * Called by the IDE task when its queue is empty and on each idle tick
+ * Closes a stream that was not used for a whole tick or that another SPI bus user is waiting for
+ * @param unit Pointer to the unit structure
+ * @param tick true if the idle timer expired
+ * @returns true while the unit still needs idle ticks
+*/
+bool sd_idle(struct IDEUnit *unit, bool tick)
+{
+    if (unit->streamState == sdStream_None)
+        return false;
+
+    if ((tick && !unit->streamActive) || spi_contended(&unit->sd_card_info.spi)) {
+        sd_stream_close(unit);
+        return false;
+    }
+
+    if (tick)
+        unit->streamActive = false;
+
+    return true;
+}
+
+/**
+ * sd_change_state
+ *
+ * Check that the card is still there for TD_CHANGESTATE and the disk change task
+ * A present card is asked for its status with CMD13, an empty slot is probed by bringing up a card again
+ * A card with an open stream answered the last request so it is not disturbed
+ * @param unit Pointer to the unit structure
+ * @returns true if a card is present
+*/
+bool sd_change_state(struct IDEUnit *unit)
+{
+    sd_card_info_t *ci = &unit->sd_card_info;
+    uint8_t res;
+    uint8_t status;
+
+    if (unit->mediumPresent) {
+        if (unit->streamState != sdStream_None)
+            return true;
+
+        sd_claim_bus(unit);
+        res = sd_send_cmd(ci, CMD13, 0);
+        status = 0xff;
+        if (res != 0xff) {
+            /* Second byte of the R2 response */
+            spi_read(&ci->spi, &status, 1);
+        }
+        sd_session_end(ci);
+
+        /* No response, or the card went back to idle after a power cycle */
+        if (res == 0xff || (res & 0x01) || status == 0xff) {
+            Info("SD card removed\n");
+            ci->type = sdCardType_None;
+            unit->mediumPresent = false;
+            unit->changeCount++;
+        }
+    } else {
+        sd_claim_bus(unit);
+        if (sd_init_card(unit)) {
+            Info("SD card inserted\n");
+            /* Keep the transfer routine picked at startup or with CMD_XFER, it only depends on the CPU */
+            ata_set_xfer(unit, unit->xferMethod);
+            unit->mediumPresent = true;
+            unit->changeCount++;
+            sd_compute_chs_geometry(unit);
+        }
+    }
+
+    return unit->mediumPresent;
 }
 
 /**
  * ata_set_xfer
  *
- * Sets the transfer routine for the SD card
- * NOT IMPLEMENTED ON SD CARD DRIVER
+ * Sets the SPI transfer kernels for the SD card
  *
  * @param unit Pointer to an IDEUnit strict
  * @param method Transfer routine
  */
 void ata_set_xfer(struct IDEUnit *unit, enum xfer method)
 {
+    switch (method) {
+        default:
+        case spi_xfer_68000:
+            spi_set_xfer(&unit->sd_card_info.spi, SPI_XFER_68000);
+            unit->xferMethod = spi_xfer_68000;
+            break;
+        case spi_xfer_68020:
+            spi_set_xfer(&unit->sd_card_info.spi, SPI_XFER_68020);
+            unit->xferMethod = spi_xfer_68020;
+            break;
+    }
 }
 
 /**
@@ -783,6 +1185,31 @@ BYTE ata_set_pio(struct IDEUnit *unit, UBYTE pio)
     return IOERR_NOCMD;
 }
 
+/**
+ * ata_configure_multiple
+ *
+ * NOT IMPLEMENTED ON SD CARD DRIVER
+ *
+ * @param unit Pointer to an IDEUnit struct
+ * @param multiple DRQ block size
+*/
+BYTE ata_configure_multiple(struct IDEUnit *unit, UBYTE multiple)
+{
+    return IOERR_NOCMD;
+}
+
+/**
+ * ata_tune_multiple
+ *
+ * NOT IMPLEMENTED ON SD CARD DRIVER
+ *
+ * @param unit Pointer to an IDEUnit struct
+*/
+BYTE ata_tune_multiple(struct IDEUnit *unit)
+{
+    return IOERR_NOCMD;
+}
+
 /**
  * scsi_ata_passthrough
  *
@@ -816,6 +1243,25 @@ BYTE atapi_test_unit_ready(struct IDEUnit *unit)
     return IOERR_NOCMD;
 }
 
+BYTE atapi_check_media(struct IDEUnit *unit)
+{
+    return IOERR_NOCMD;
+}
+
+void atapi_medium_written(struct IDEUnit *unit)
+{
+}
+
+bool atapi_scsi_read_toc(struct SCSICmd *cmd, struct IDEUnit *unit)
+{
+    return false;
+}
+
+bool atapi_scsi_read_capacity(struct SCSICmd *cmd, struct IDEUnit *unit)
+{
+    return false;
+}
+
 BYTE atapi_check_wp(struct IDEUnit *unit)
 {
     return IOERR_NOCMD;
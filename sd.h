@@ -33,8 +33,18 @@ bool ata_init_unit(struct IDEUnit *);
 bool ata_identify(struct IDEUnit *, UWORD *);
 BYTE ata_read(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit);
 BYTE ata_write(void *buffer, ULONG lba, ULONG count, struct IDEUnit *unit);
+BYTE ata_read_sg(struct SGEntry *sg, ULONG lba, ULONG count, struct IDEUnit *unit);
+BYTE ata_write_sg(struct SGEntry *sg, ULONG lba, ULONG count, struct IDEUnit *unit);
+BYTE ata_flush(struct IDEUnit *unit);
 void ata_set_xfer(struct IDEUnit *unit, enum xfer method);
 BYTE ata_set_pio(struct IDEUnit *unit, UBYTE pio);
+BYTE ata_configure_multiple(struct IDEUnit *unit, UBYTE multiple);
+BYTE ata_tune_multiple(struct IDEUnit *unit);
 BYTE scsi_ata_passthrough( struct IDEUnit *unit, struct SCSICmd *cmd);
 
+//SD functions
+void sd_stream_close(struct IDEUnit *unit);
+bool sd_idle(struct IDEUnit *unit, bool tick);
+bool sd_change_state(struct IDEUnit *unit);
+
 #endif // SD_H_INCLUDED
@@ -58,6 +58,12 @@ typedef enum {
 	sdBlockSize_16384,
 } sd_blocksize_t;
 
+typedef enum {
+	sdStream_None = 0,
+	sdStream_Read,
+	sdStream_Write,
+} sd_stream_t;
+
 typedef struct {
 	uint8_t		csd_structure;				/*!< CSD structure */
 	uint8_t		spec_version;				/*!< MMC spec version (not SD) */
@@ -108,6 +114,9 @@ typedef struct {
 	sd_card_csd_t		csd;
 	sd_card_cid_t		cid;
 	spi_t               spi;
+	uint8_t             selected;       /*!< bus obtained and /CS asserted */
+	uint8_t             busy;           /*!< card may be busy programming or stopping */
+	uint32_t            au_sectors;     /*!< allocation unit size in sectors, 0 if unknown */
 } sd_card_info_t;
 
 #endif
@@ -25,6 +25,10 @@
 extern void spi_chip_select(UBYTE select asm("d0"), UBYTE *port asm("a1"));
 extern void spi_read_fast(UBYTE *buf asm("a0"), UWORD size asm("d0"), UBYTE *port asm("a1"));
 extern void spi_write_fast(const UBYTE *buf asm("a0"), UWORD size asm("d0"), UBYTE *port asm("a1"));
+extern void spi_read_fast_020(UBYTE *buf asm("a0"), UWORD size asm("d0"), UBYTE *port asm("a1"));
+extern void spi_write_fast_020(const UBYTE *buf asm("a0"), UWORD size asm("d0"), UBYTE *port asm("a1"));
+extern ULONG spi_poll_eq(UWORD mask_match asm("d0"), ULONG budget asm("d1"), UBYTE *port asm("a1"));
+extern ULONG spi_poll_ne(UWORD mask_match asm("d0"), ULONG budget asm("d1"), UBYTE *port asm("a1"));
 
 //obtain the bus
 void spi_obtain(spi_t *spi)
@@ -50,6 +54,14 @@ void spi_release(spi_t *spi)
 	}
 }
 
+//check if another user is waiting for the bus we hold
+int spi_contended(spi_t *spi)
+{
+	struct MinList *waitq = (struct MinList *)&spi->sspi->semaphore.ss_WaitQueue;
+
+	return spi->bus_taken && waitq->mlh_Head->mln_Succ != NULL;
+}
+
 //select the channel (assert chip_select)
 void spi_select(spi_t *spi)
 {
@@ -70,34 +82,44 @@ void spi_set_speed(spi_t *spi, UBYTE speed)
 	spi->speed = speed;
 }
 
-// A slow SPI transfer takes 32 us (8 bits times 4us (250kHz))
-// An E-cycle is 1.4 us.
-static void wait_40_us()
+//select the transfer kernels used at fast speed
+//all of them run on any CPU, the 68020 ones move longwords and fit in the instruction cache
+void spi_set_xfer(spi_t *spi, UBYTE xfer)
 {
-    volatile UBYTE *cia_b_pra = (volatile UBYTE *)0xbfd000;
-    volatile UBYTE tmp;
-
-	for (int i = 0; i < 32; i++)
-		tmp = *cia_b_pra;
+	if (xfer == SPI_XFER_68020)
+	{
+		spi->read_fast  = &spi_read_fast_020;
+		spi->write_fast = &spi_write_fast_020;
+	}
+	else
+	{
+		xfer = SPI_XFER_68000;
+		spi->read_fast  = &spi_read_fast;
+		spi->write_fast = &spi_write_fast;
+	}
+	spi->xfer = xfer;
 }
 
+// A slow SPI transfer takes 32 us (8 bits times 4us (250kHz))
+#define SPI_SLOW_DELAY_US	40
+
 //slowed down write
-static void spi_write_slow(const UBYTE *buf asm("a0"), UWORD size asm("d0"))
+static void spi_write_slow(spi_t *spi, const UBYTE *buf, UWORD size)
 {
 	for (UWORD i = 0; i < size; i++)
 	{
 		spi_write_fast(buf++, 1, (UBYTE *)(SSPI_BASE_ADDRESS+1));
-		wait_40_us();
+		timer_delay(&spi->timebase, SPI_SLOW_DELAY_US);
 	}
 }
 
 //slowed down read
-static void spi_read_slow(UBYTE *buf asm("a0"), UWORD size asm("d0"))
+static void spi_read_slow(spi_t *spi, UBYTE *buf, UWORD size)
 {
 	for (UWORD i = 0; i < size; i++)
 	{
 		spi_read_fast(buf++, 1, (UBYTE *)(SSPI_BASE_ADDRESS+1));
-		wait_40_us();
+		timer_delay(&spi->timebase, SPI_SLOW_DELAY_US);
 	}
 }
 
@@ -105,18 +127,49 @@ static void spi_read_slow(UBYTE *buf asm("a0"), UWORD size asm("d0"))
 void spi_read(spi_t *spi asm("a1"), UBYTE *buf asm("a0"), UWORD size asm("d0"))
 {
 	if (spi->speed == SPI_SPEED_FAST)
-		spi_read_fast(buf, size, (UBYTE *)(SSPI_BASE_ADDRESS+1));
+		spi->read_fast(buf, size, (UBYTE *)(SSPI_BASE_ADDRESS+1));
 	else
-		spi_read_slow(buf, size);
+		spi_read_slow(spi, buf, size);
 }
 
 //write <size> bytes from <buf> to the SPI bus
 void spi_write(spi_t *spi asm("a1"), const UBYTE *buf asm("a0"), UWORD size asm("d0"))
 {
 	if (spi->speed == SPI_SPEED_FAST)
-		spi_write_fast(buf, size, (UBYTE *)(SSPI_BASE_ADDRESS+1));
+		spi->write_fast(buf, size, (UBYTE *)(SSPI_BASE_ADDRESS+1));
 	else
-		spi_write_slow(buf, size);
+		spi_write_slow(spi, buf, size);
+}
+
+//read bytes until (byte & <mask>) == <match>, or != <match> if <equal> is false
+//at most <budget> bytes are read, returns the number of bytes read << 8 | the last byte read
+ULONG spi_poll(spi_t *spi, UBYTE mask, UBYTE match, BOOL equal, ULONG budget)
+{
+	UWORD mask_match = ((UWORD)mask << 8) | match;
+	ULONG count = 0;
+	UBYTE in;
+
+	if (budget == 0)
+		budget = 1;
+	else if (budget > SPI_POLL_MAX_BUDGET)
+		budget = SPI_POLL_MAX_BUDGET;
+
+	if (spi->speed == SPI_SPEED_FAST)
+	{
+		if (equal)
+			return spi_poll_eq(mask_match, budget, (UBYTE *)(SSPI_BASE_ADDRESS+1));
+		else
+			return spi_poll_ne(mask_match, budget, (UBYTE *)(SSPI_BASE_ADDRESS+1));
+	}
+
+	do
+	{
+		spi_read_slow(spi, &in, 1);
+		count++;
+	}
+	while ((((in & mask) == match) != equal) && count < budget);
+
+	return (count << 8) | in;
 }
 
 //initialize SPI hardware, <channel> sets chipselect to use
@@ -165,6 +218,12 @@ int spi_initialize(spi_t *spi, unsigned char channel, struct ExecBase *SysBase)
 	//initial speed is slow
 	spi->speed = SPI_SPEED_SLOW;
 
+	//the TOD until the caller provides timer.device with timer_init()
+	timer_init(&spi->timebase, NULL);
+
+	//68000 transfer kernels until a faster one is selected
+	spi_set_xfer(spi, SPI_XFER_68000);
+
 	return 1;
 }
 
@@ -21,6 +21,7 @@
 #define SPI_H_INCLUDED
 
 #include <exec/exec.h>
+#include "timer.h"
 
 #define SSPI_BASE_ADDRESS	0x00EC0000
 
@@ -30,7 +31,15 @@
 #define SPI_CHANNEL_1		0x01
 #define SPI_CHANNEL_2		0x02
 
+#define SPI_XFER_68000		0			// transfer kernels, see spi_set_xfer()
+#define SPI_XFER_68020		1
+
 #define SSPI_RESOURCE_NAME	"sspi"
+
+//spi_poll() result: last byte read and the number of bytes read
+#define SPI_POLL_MAX_BUDGET	0x00FFFFFF
+#define SPI_POLL_BYTE(r)	((UBYTE)(r))
+#define SPI_POLL_COUNT(r)	((ULONG)(r) >> 8)
 
 //sspi resource
 struct sspi_resource_TYPE
@@ -54,16 +63,23 @@ typedef struct
     UBYTE                       speed;      // bus speed
     UBYTE                       bus_taken;  // bus status
     UBYTE                       channel;    // SPI channel (chip_select) to use;
+    UBYTE                       xfer;       // transfer kernel in use (SPI_XFER_x)
+    TIMEBASE                    timebase;   // clock for delays and timeouts
+    void (*read_fast)(UBYTE *buf asm("a0"), UWORD size asm("d0"), UBYTE *port asm("a1"));
+    void (*write_fast)(const UBYTE *buf asm("a0"), UWORD size asm("d0"), UBYTE *port asm("a1"));
 }spi_t;
 
 //functions
 void spi_obtain(spi_t *spi);
 void spi_release(spi_t *spi);
+int spi_contended(spi_t *spi);
 void spi_select(spi_t *spi);
 void spi_deselect();
 void spi_set_speed(spi_t *spi, UBYTE speed);
+void spi_set_xfer(spi_t *spi, UBYTE xfer);
 void spi_read(spi_t *spi asm("a1"), UBYTE *buf asm("a0"), UWORD size asm("d0"));
 void spi_write(spi_t *spi asm("a1"), const UBYTE *buf asm("a0"), UWORD size asm("d0"));
+ULONG spi_poll(spi_t *spi, UBYTE mask, UBYTE match, BOOL equal, ULONG budget);
 int spi_initialize(spi_t *spi, unsigned char channel, struct ExecBase *SysBase);
 void spi_shutdown(spi_t *spi);
 
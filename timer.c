@@ -18,42 +18,101 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>. 
  */
 
+#include <devices/timer.h>
+#include <inline/timer.h>
 #include "timer.h"
 
+#define TIMER_TOD_MASK		0x00ffffff		// the TOD is a 24 bit counter
+#define TIMER_ECLOCK_NS		1400			// a CIA register access is synced to one E clock cycle
+
 static volatile uint8_t * const todl = (volatile uint8_t*)0xbfe801;
+static volatile uint8_t * const todm = (volatile uint8_t*)0xbfe901;
+static volatile uint8_t * const todh = (volatile uint8_t*)0xbfea01;
+static volatile uint8_t * const ciab_pra = (volatile uint8_t*)0xbfd000;
+
+//select the clock, <TimerBase> may be NULL
+//ReadEClock needs timer.device V36, Kickstart 1.3 falls back to the TOD
+void timer_init(TIMEBASE *tb, struct Device *TimerBase)
+{
+	struct EClockVal ev;
+
+	if (TimerBase != NULL && TimerBase->dd_Library.lib_Version >= 36)
+	{
+		tb->TimerBase = TimerBase;
+		tb->freq = ReadEClock(&ev);
+	}
+	else
+	{
+		tb->TimerBase = NULL;
+		tb->freq = TIMER_TICK_FREQ;
+	}
+}
 
-//get 8bit timer count
-uint8_t timer_get(void)
+//get the current clock value
+uint32_t timer_now(TIMEBASE *tb)
 {
-	uint8_t l;
+	struct Device *TimerBase = tb->TimerBase;
+	struct EClockVal ev;
+	uint32_t t;
+
+	if (TimerBase != NULL)
+	{
+		ReadEClock(&ev);
+		return ev.ev_lo;
+	}
 
 	/* TOD registers latch on reading MSB, unlatch on reading LSB */
-	l = *todl;
-	
-	return l;
+	t  = (uint32_t)*todh << 16;
+	t |= (uint32_t)*todm << 8;
+	t |= *todl;
+	return t;
 }
 
-//wait <ticks> ticks
-//maximum wait time is 255 ticks
-void timer_wait(uint8_t ticks)
+//convert microseconds to clock ticks, rounding up
+static uint32_t timer_ticks(TIMEBASE *tb, uint32_t us)
 {
-	uint8_t start = timer_get();
-	while ((uint8_t)(timer_get() - start) < ticks);
+	if (tb->TimerBase == NULL)
+		return (us + (1000000ul / TIMER_TICK_FREQ) - 1) / (1000000ul / TIMER_TICK_FREQ);
+
+	return (us / 1000000ul) * tb->freq + ((us % 1000000ul) * (tb->freq / 1000ul) + 999ul) / 1000ul;
 }
 
-//set a timer to expire over <ticks> ticks
-//poll if timer is expired using timer_check()
-//maximum timer setting is 128 ticks
-TIMER timer_set(uint8_t ticks)
+//start a timeout of <us> microseconds
+//poll it with timer_check(), or with timer_poll() which reads the clock only every <every> calls
+void timer_start(TIMEBASE *tb, TIMER *timer, uint32_t us, uint16_t every)
 {
-	if(ticks>128)
-		ticks = 128;
-	return( timer_get() + ticks );
+	timer->deadline = timer_now(tb) + timer_ticks(tb, us);
+	timer->every = (every) ? every : 1;
+	timer->countdown = timer->every;
 }
 
 //return true if timer expired
-uint8_t timer_check(TIMER timer)
+uint8_t timer_check(TIMEBASE *tb, TIMER *timer)
 {
-	//note: casting to int8_t and checking if less than zero gives timing glitches
-	return ( (uint8_t)(timer_get()-timer) > 127 ) ? 0 : 1;
+	uint32_t diff = timer_now(tb) - timer->deadline;
+
+	if (tb->TimerBase == NULL)
+		return ((diff & TIMER_TOD_MASK) & 0x00800000) ? 0 : 1;
+
+	return ((int32_t)diff < 0) ? 0 : 1;
+}
+
+//wait <us> microseconds
+//delays shorter than a TOD tick are timed with CIA accesses when ReadEClock is not available
+void timer_delay(TIMEBASE *tb, uint32_t us)
+{
+	TIMER timer;
+
+	if (tb->TimerBase == NULL && us < (1000000ul / TIMER_TICK_FREQ))
+	{
+		volatile uint8_t tmp;
+
+		for (uint32_t i = (us * 1000ul) / TIMER_ECLOCK_NS; i > 0; i--)
+			tmp = *ciab_pra;
+		(void)tmp;
+		return;
+	}
+
+	timer_start(tb, &timer, us, 1);
+	while (!timer_check(tb, &timer));
 }
@@ -20,23 +20,45 @@
 #ifndef TIMER_H_
 #define TIMER_H_
 
+#include <exec/types.h>
+#include <exec/devices.h>
 #include <stdint.h>
 
 #ifndef TIMER_TICK_FREQ
-/*! Tick frequency in Hz - defines timer resolution */
+/*! TOD tick frequency in Hz - resolution of the fallback used without ReadEClock */
 #define TIMER_TICK_FREQ			60
 #endif
 
-/*! Helper macro calculates number of ticks in specified ms (rounds up) */
-#define TIMER_MILLIS(ms)		(((uint32_t)(ms) * (TIMER_TICK_FREQ) + 999ul) / 1000ul)
+/*! Helper macros give timeouts in microseconds */
+#define TIMER_MICROS(us)		((uint32_t)(us))
+#define TIMER_MILLIS(ms)		((uint32_t)(ms) * 1000ul)
 
-/*! timer type */
-typedef uint8_t TIMER;
+/*! Clock used for timeouts, the E clock through ReadEClock or the CIA-A TOD on Kickstart 1.3 */
+typedef struct {
+	struct Device	*TimerBase;		/*!< timer.device for ReadEClock, NULL to use the TOD */
+	uint32_t		freq;			/*!< clock ticks per second */
+} TIMEBASE;
 
+/*! Timeout, started with timer_start() */
+typedef struct {
+	uint32_t		deadline;		/*!< clock value the timeout expires at */
+	uint16_t		every;			/*!< timer_poll() only reads the clock every so many calls */
+	uint16_t		countdown;		/*!< calls left until timer_poll() reads the clock */
+} TIMER;
 
-void timer_wait(uint8_t ticks);
-TIMER timer_set(uint8_t ticks);
-uint8_t timer_check(TIMER timer);
+void timer_init(TIMEBASE *tb, struct Device *TimerBase);
+uint32_t timer_now(TIMEBASE *tb);
+void timer_start(TIMEBASE *tb, TIMER *timer, uint32_t us, uint16_t every);
+uint8_t timer_check(TIMEBASE *tb, TIMER *timer);
+void timer_delay(TIMEBASE *tb, uint32_t us);
 
+/*! Cheap check for hot loops, the clock is only read every <every> calls */
+static inline uint8_t timer_poll(TIMEBASE *tb, TIMER *timer)
+{
+	if (--timer->countdown)
+		return 0;
+	timer->countdown = timer->every;
+	return timer_check(tb, timer);
+}
 
 #endif /* TIMER_H_ */